@@ -1,13 +1,14 @@
 #include "../include/BigInt.hpp"
+#include "../include/Mpn.hpp"
+#include "../include/ScratchArena.hpp"
+#include "../include/Stats.hpp"
 
 /* ***************************************************
  *              BIGINT CLASS METHODS               *
  ***************************************************  */
 
 // Default constructor
-BigInt::BigInt() : digits(std::vector<uint>(1, 0)), positive(true) {
-    digits.reserve(8);
-} 
+BigInt::BigInt() : digits(1, 0), positive(true) {}
 
 // Copy constructor
 BigInt::BigInt(const BigInt &other)
@@ -42,53 +43,294 @@ BigInt::BigInt(double num) {
     init<double>(num);
 }
 
+namespace {
+// the value of every digit character in bases up to 16, 0xff for characters that are not digits
+const std::array<byte, 256> &digit_values() {
+    static const std::array<byte, 256> values = [] {
+        std::array<byte, 256> table;
+        table.fill(0xff);
+        for (byte i = 0; i < 10; ++i) {
+            table['0' + i] = i;
+        }
+        for (byte i = 0; i < 6; ++i) {
+            table['a' + i] = table['A' + i] = (byte)(10 + i);
+        }
+        return table;
+    }();
+    return values;
+}
+
+// the digits of every chunk_bits-bit value in a power of two base, most significant first: chars[v * per_chunk]
+// starts the per_chunk = chunk_bits / digit_bits digits of v. base 2 and 16 go a byte at a time, base 8 needs
+// chunks that are a multiple of 3 bits and takes 12 (4096 entries of 4 digits)
+struct RadixTable {
+    unsigned digit_bits;
+    unsigned chunk_bits;
+    size_t per_chunk;
+    std::vector<char> chars;
+
+    RadixTable(unsigned digit_bits_in, unsigned chunk_bits_in)
+        : digit_bits(digit_bits_in), chunk_bits(chunk_bits_in), per_chunk(chunk_bits_in / digit_bits_in),
+          chars(((size_t)1 << chunk_bits_in) * per_chunk) {
+        for (size_t v = 0; v < ((size_t)1 << chunk_bits); ++v) {
+            for (size_t j = 0; j < per_chunk; ++j) {
+                chars[v * per_chunk + j] = "0123456789abcdef"[(v >> ((per_chunk - 1 - j) * digit_bits)) & ((1u << digit_bits) - 1)];
+            }
+        }
+    }
+};
+
+const RadixTable &radix_table(unsigned base) {
+    static const RadixTable binary(1, 8), octal(3, 12), hex(4, 8);
+    return base == 2 ? binary : base == 8 ? octal : hex;
+}
+
+// bits [offset, offset + count) of a, count < BITS_IN_LIMB, bits past the end of a are zero
+limb extract_bits(std::span<const limb> a, size_t offset, unsigned count) {
+    const size_t index = offset / BITS_IN_LIMB, shift = offset % BITS_IN_LIMB;
+    if (index >= a.size()) {
+        return 0;
+    }
+    limb bits = a[index] >> shift;
+    if (shift + count > BITS_IN_LIMB && index + 1 < a.size()) {
+        bits |= a[index + 1] << (BITS_IN_LIMB - shift);
+    }
+    return bits & (((limb)1 << count) - 1);
+}
+
+// appends the digits of the bits-bit magnitude a (at least one digit) in table's base, a chunk of digits per lookup
+void append_radix(std::string &out, std::span<const limb> a, size_t bits, const RadixTable &table) {
+    const size_t length = std::max<size_t>(1, (bits + table.digit_bits - 1) / table.digit_bits);
+    const size_t chunks = (length + table.per_chunk - 1) / table.per_chunk;
+    const size_t start = out.size();
+    out.resize(start + chunks * table.per_chunk);
+    char *digits_out = out.data() + start + chunks * table.per_chunk;
+    for (size_t i = 0; i < chunks; ++i) { // chunk i fills the i-th group of digits from the right
+        const char *chars = &table.chars[extract_bits(a, i * table.chunk_bits, table.chunk_bits) * table.per_chunk];
+        digits_out -= table.per_chunk;
+        for (size_t j = 0; j < table.per_chunk; ++j) {
+            digits_out[j] = chars[j];
+        }
+    }
+    out.erase(start, chunks * table.per_chunk - length); // the top chunk's leading zeros
+}
+
+// true if any of the low bits bits of a is set
+bool any_low_bits(std::span<const limb> a, size_t bits) {
+    const size_t limbs = std::min(bits / BITS_IN_LIMB, a.size());
+    if (std::any_of(a.begin(), a.begin() + limbs, [](limb x) { return x != 0; })) {
+        return true;
+    }
+    return limbs < a.size() && bits % BITS_IN_LIMB && (a[limbs] & (((limb)1 << (bits % BITS_IN_LIMB)) - 1)) != 0;
+}
+} // namespace
+
+// decimal string constructor, accepts an optional sign followed by one or more decimal digits
+BigInt::BigInt(std::string_view str) : positive(true) {
+    bool is_positive = true;
+    if (!str.empty() && (str[0] == '-' || str[0] == '+')) {
+        is_positive = str[0] == '+';
+        str.remove_prefix(1);
+    }
+    if (str.empty() || !std::all_of(str.begin(), str.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        throw std::invalid_argument("BigInt: not a decimal integer");
+    }
+    BIGINT_STAT_SCOPE(PARSE, str.size() * 10 / 3 / BITS_IN_LIMB + 1); // about log2(10) bits per decimal digit
+    *this = parse_decimal(str);
+    positive = is_positive;
+    trim();
+}
+
+// string constructor for base 2, 8, 10 or 16. the power of two bases drop each digit's bits straight into place
+// from the least significant end, O(n) with one table lookup per digit
+BigInt::BigInt(std::string_view str, unsigned base) : positive(true) {
+    if (base == 10) {
+        *this = BigInt(str);
+        return;
+    }
+    if (base != 2 && base != 8 && base != 16) {
+        throw std::invalid_argument("BigInt: base must be 2, 8, 10 or 16");
+    }
+    bool is_positive = true;
+    if (!str.empty() && (str[0] == '-' || str[0] == '+')) {
+        is_positive = str[0] == '+';
+        str.remove_prefix(1);
+    }
+    if (str.empty()) {
+        throw std::invalid_argument("BigInt: not a base " + std::to_string(base) + " integer");
+    }
+    const std::array<byte, 256> &values = digit_values();
+    const unsigned digit_bits = std::countr_zero(base);
+    digits.resize((str.size() * digit_bits + BITS_IN_LIMB - 1) / BITS_IN_LIMB, 0);
+    size_t offset = 0;
+    for (size_t i = str.size(); i-- > 0; offset += digit_bits) {
+        const limb value = values[(unsigned char)str[i]];
+        if (value >= base) {
+            throw std::invalid_argument("BigInt: not a base " + std::to_string(base) + " integer");
+        }
+        const size_t index = offset / BITS_IN_LIMB, shift = offset % BITS_IN_LIMB;
+        digits[index] |= value << shift;
+        if (shift + digit_bits > BITS_IN_LIMB) { // octal digits can straddle two limbs
+            digits[index + 1] |= value >> (BITS_IN_LIMB - shift);
+        }
+    }
+    positive = is_positive;
+    trim();
+}
+
+// stream constructor, skips leading whitespace then reads an optional sign and decimal digits.
+// sets failbit on the stream (leaving the value zero) if no digits were found
+BigInt::BigInt(std::istream &in) : BigInt() {
+    std::istream::sentry sentry(in);
+    if (!sentry) {
+        return;
+    }
+    std::string str;
+    std::streambuf *buf = in.rdbuf();
+    int c = buf->sgetc();
+    if (c == '-' || c == '+') {
+        str.push_back((char)c);
+        c = buf->snextc();
+    }
+    while (c != std::char_traits<char>::eof() && c >= '0' && c <= '9') {
+        str.push_back((char)c);
+        c = buf->snextc();
+    }
+    if (c == std::char_traits<char>::eof()) {
+        in.setstate(std::ios_base::eofbit);
+    }
+    if (str.empty() || str.back() < '0' || str.back() > '9') {
+        in.setstate(std::ios_base::failbit);
+        return;
+    }
+    *this = BigInt(std::string_view(str));
+}
+
 // Private constructor for initialization with digits and sign
-BigInt::BigInt(const std::vector<uint> &digits_in, const bool is_positive)
-    : digits(digits_in), positive(is_positive) {}
+BigInt::BigInt(digit_vector digits_in, const bool is_positive)
+    : digits(std::move(digits_in)), positive(is_positive) {
+    trim();
+}
 
 // Constructor helper function, initializes BigInt from primitive number types
 template <typename T>
 void BigInt::init(T _num) {
     static_assert(std::is_arithmetic<T>::value, "Not an arithmetic type :/");
     positive = (_num >= 0) ? true : false;
-    _long num = static_cast<_long>(abs(_num));
-    int num_digits = num == 0 ? 1 : static_cast<int>(log10(num));
+    _long num = static_cast<_long>(std::abs(_num));
 
-    digits.reserve(num_digits);
-    for (_long n = num; n > 0; n /= BASE) {
-        digits.push_back(n % BASE);
+    for (dlimb n = num; n > 0; n /= BASE) {
+        digits.push_back((limb)(n % BASE));
     }
     if (digits.size() == 0)
         digits.push_back(0);
 }
 
-// return binary string representation of BigInt
+// strip leading zero digits so every value has a unique representation (zero is always positive)
+void BigInt::trim() {
+    size_t n = digits.size();
+    while (n > 1 && digits[n - 1] == 0) {
+        --n;
+    }
+    digits.resize(std::max<size_t>(n, 1), 0); // only grows for a moved-from (empty) BigInt
+    if (digits.size() == 1 && digits[0] == 0) {
+        positive = true;
+    }
+}
+
+// number of significant bits in the magnitude of this BigInt (0 for zero)
+size_t BigInt::bit_length() const {
+    limb top = digits.back();
+    return (num_digits() - 1) * BITS_IN_LIMB + (BITS_IN_LIMB - std::countl_zero(top));
+}
+
+// returns the magnitude of digits [lo, hi) as a positive BigInt, i.e. (|*this| / BASE^lo) % BASE^(hi-lo)
+BigInt BigInt::limb_slice(size_t lo, size_t hi) const {
+    hi = std::min(hi, num_digits());
+    if (lo >= hi) {
+        return BigInt();
+    }
+    return BigInt(digit_vector(digits.begin() + lo, digits.begin() + hi), true);
+}
+
+// returns |*this| * 2^bits
+BigInt BigInt::shifted_left(size_t bits) const {
+    const size_t limbs = bits / BITS_IN_LIMB;
+    const size_t n = num_digits();
+    digit_vector result_digits(limbs + n + 1, 0);
+    const std::span<limb> result(result_digits);
+    result[limbs + n] = mpn::lshift(result.subspan(limbs, n), digits, bits % BITS_IN_LIMB);
+    return BigInt(std::move(result_digits), true);
+}
+
+// returns |*this| / 2^bits
+BigInt BigInt::shifted_right(size_t bits) const {
+    const size_t limbs = bits / BITS_IN_LIMB;
+    if (limbs >= num_digits()) {
+        return BigInt();
+    }
+    digit_vector result_digits(num_digits() - limbs);
+    mpn::rshift(result_digits, std::span<const limb>(digits).subspan(limbs), bits % BITS_IN_LIMB);
+    return BigInt(std::move(result_digits), true);
+}
+
+// compares |a| and |b|, returns -1, 0 or 1 if |a| is less than, equal to or greater than |b|
+int BigInt::compare_magnitudes(const BigInt &a, const BigInt &b) {
+    size_t a_size = a.num_digits();
+    size_t b_size = b.num_digits();
+    if (a_size != b_size) {
+        return a_size < b_size ? -1 : 1;
+    }
+    return mpn::cmp(a.digits, b.digits);
+}
+
+// return binary string representation of the magnitude of BigInt, empty for zero
 std::string BigInt::to_binary_string() const {
+    BIGINT_STAT_SCOPE(TO_BINARY_STRING, num_digits());
     std::string bin_str = "";
-    uint mask = 1 << (BITS_IN_UINT - 1);                  // mask to extract leftmost bit (MSB) of uint digit
-    bool still_leading_zeros = true;                      // want to flag when we are done with leading zeros so we can exclude them
-    for (size_t i = this->num_digits(); i-- > 0;) { // for each digit in this BigInt
-        uint digit_copy = this->digits[(size_t)i];
-        for (size_t j = 0; j < BITS_IN_UINT; ++j) {                               // for each bit in this uint digit
-            char bit = (char)('0' + ((digit_copy & mask) >> (BITS_IN_UINT - 1))); // extract bit and convert to character representation
-            if (!still_leading_zeros) {
-                bin_str.push_back(bit); // append bit to string if we're done with leading zeros
-            } else if (bit == '1') {
-                bin_str.push_back(bit); // append first non-zero bit and flag that leading zeros are passed
-                still_leading_zeros = false;
-            }
-            digit_copy <<= 1;
-        }
+    const size_t bits = bit_length();
+    if (bits > 0) {
+        append_radix(bin_str, digits, bits, radix_table(2));
     }
     return bin_str;
 }
 
-std::string BigInt::to_string() const {
+std::string BigInt::to_string(unsigned base) const {
+    if (base == 10) {
+        return to_string();
+    }
+    if (base != 2 && base != 8 && base != 16) {
+        throw std::invalid_argument("BigInt: base must be 2, 8, 10 or 16");
+    }
+    std::string result = positive ? "" : "-";
+    append_radix(result, digits, bit_length(), radix_table(base));
+    return result;
+}
+
+// returns 10^(9 * 2^k), i.e. BIGGEST_POW10^(2^k). powers are computed once by repeated squaring and
+// cached for the lifetime of the program, references stay valid since deque growth never moves elements
+const BigInt &BigInt::pow10_power(size_t k) {
+    static std::deque<BigInt> powers;
+    static std::mutex powers_mutex;
+    std::lock_guard<std::mutex> lock(powers_mutex);
+    if (powers.empty()) {
+        powers.push_back(BigInt((long long)BIGGEST_POW10));
+    }
+    while (powers.size() <= k) {
+        powers.push_back(powers.back() * powers.back());
+    }
+    return powers[k];
+}
+
+// appends the decimal digits of |*this| to out, left-padded with zeros to width digits (0 means no padding).
+// converts 32 bits at a time into base 10^9 chunks so the chunk arithmetic fits in 64 bits whatever the limb size,
+// complexity O(n^2)
+void BigInt::append_decimal(std::string &out, size_t width) const {
     std::vector<uint> base10_chunks;
-    base10_chunks.reserve((size_t)(((this->num_digits() * BITS_IN_UINT) * 0.30103 ) / 9) + 1);
+    base10_chunks.reserve((size_t)(((this->num_digits() * BITS_IN_LIMB) * 0.30103 ) / 9) + 1);
     size_t size = 0;
-    for (size_t i = this->num_digits(); i-- > 0;) {
-        ulonglong hi = this->digits[i];
+    for (size_t i = this->num_digits() * UINTS_IN_LIMB; i-- > 0;) {
+        ulonglong hi = (uint)(this->digits[i / UINTS_IN_LIMB] >> (BITS_IN_UINT * (i % UINTS_IN_LIMB)));
         for (size_t j = 0; j < size; ++j) {
             ulonglong extended = (ulonglong)base10_chunks[j] << BITS_IN_UINT | (uint)hi;
             hi = extended / BIGGEST_POW10;
@@ -101,46 +343,117 @@ std::string BigInt::to_string() const {
         }
     }
 
-    if (base10_chunks.size() == 0) {
-        return "0";
+    if (base10_chunks.empty()) {
+        out.append(width ? width : 1, '0');
+        return;
     }
 
-    std::string base10 = this->positive ? "" : "-";
-    base10.reserve(POW10_DIGITS * base10_chunks.size());
-    size_t prev = this->positive ? 0 : 1;
-	size_t chunks_added = 0;
-    for (size_t i = base10_chunks.size(); i-- > 0;) {
-		int cnt = 0;
-        while (base10_chunks[i]) {
-			base10.push_back('0' + base10_chunks[i] % 10);
-			base10_chunks[i] /= 10;
-			++cnt;
+    const std::string top = std::to_string(base10_chunks.back());
+    const size_t num_decimal = top.size() + POW10_DIGITS * (base10_chunks.size() - 1);
+    if (width > num_decimal) {
+        out.append(width - num_decimal, '0');
+    }
+    out += top;
+    char chunk[POW10_DIGITS];
+    for (size_t i = base10_chunks.size() - 1; i-- > 0;) { // every chunk below the top one is zero-padded to POW10_DIGITS
+        uint value = base10_chunks[i];
+        for (size_t j = POW10_DIGITS; j-- > 0;) {
+            chunk[j] = (char)('0' + value % 10);
+            value /= 10;
+        }
+        out.append(chunk, POW10_DIGITS);
+    }
+}
+
+// appends the decimal digits of x < 10^(9 * 2^(k+1)) by splitting around 10^(9 * 2^k) and converting both halves,
+// complexity O(M(n) log n) where M(n) is the cost of multiplication
+void BigInt::append_decimal_recursive(const BigInt &x, size_t k, size_t width, std::string &out) {
+    if (x.num_digits() < mpn::thresholds.to_string) {
+        x.append_decimal(out, width);
+        return;
+    }
+    if (width == 0) { // leading part is not padded, so step down to the largest split point not above x
+        while (k > 0 && x < pow10_power(k)) {
+            --k;
+        }
+    }
+    const size_t half_width = POW10_DIGITS << k;
+    BigInt high, low;
+    divmod(x, pow10_power(k), high, low);
+    append_decimal_recursive(high, k - 1, width ? width - half_width : 0, out);
+    append_decimal_recursive(low, k - 1, half_width, out);
+}
+
+// parses a string of decimal digits by splitting off the low 9 * 2^k digits and combining the halves as
+// high * 10^(9 * 2^k) + low, complexity O(M(n) log n) where M(n) is the cost of multiplication
+BigInt BigInt::parse_decimal(std::string_view str) {
+    const size_t num_chunks = (str.size() + POW10_DIGITS - 1) / POW10_DIGITS;
+    if (num_chunks > mpn::thresholds.parse) {
+        size_t k = 0;
+        while (((size_t)2 << k) < num_chunks) { // 2^k < num_chunks <= 2^(k+1)
+            ++k;
+        }
+        const size_t low_len = POW10_DIGITS << k;
+        BigInt high = parse_decimal(str.substr(0, str.size() - low_len));
+        BigInt low = parse_decimal(str.substr(str.size() - low_len));
+        return high * pow10_power(k) + low;
+    }
+
+    // few enough chunks, multiply by 10^9 and add the next chunk, complexity O(n^2)
+    digit_vector result_digits;
+    result_digits.reserve(num_chunks);
+    size_t chunk_len = str.size() - (num_chunks - 1) * POW10_DIGITS; // leading chunk may be short
+    for (size_t pos = 0; pos < str.size(); pos += chunk_len, chunk_len = POW10_DIGITS) {
+        limb overflow = 0;
+        for (size_t i = pos; i < pos + chunk_len; ++i) {
+            overflow = overflow * 10 + (uint)(str[i] - '0');
+        }
+        for (size_t i = 0; i < result_digits.size(); ++i) {
+            dlimb true_mult = (dlimb)result_digits[i] * BIGGEST_POW10 + overflow;
+            result_digits[i] = (limb)true_mult;
+            overflow = (limb)(true_mult >> BITS_IN_LIMB);
         }
-		while (i < base10_chunks.size() - 1 && cnt < POW10_DIGITS) {
-        	base10.push_back('0');
-			++cnt;
+        if (overflow) {
+            result_digits.push_back(overflow);
         }
-		std::reverse(base10.begin() + prev, base10.begin() + prev + cnt);
-        prev += cnt;
-		++chunks_added;
+    }
+    return BigInt(std::move(result_digits), true);
+}
+
+// return decimal string representation of BigInt
+std::string BigInt::to_string() const {
+    BIGINT_STAT_SCOPE(TO_STRING, num_digits());
+    std::string base10 = this->positive ? "" : "-";
+    if (this->num_digits() < mpn::thresholds.to_string) {
+        append_decimal(base10, 0);
+        return base10;
     }
 
+    // find the smallest k with |*this| < 10^(9 * 2^(k+1)) to start the split from
+    const BigInt magnitude(this->digits, true);
+    size_t k = 0;
+    while (pow10_power(k + 1) <= magnitude) {
+        ++k;
+    }
+    base10.reserve(base10.size() + (size_t)(num_digits() * BITS_IN_LIMB * 0.30103) + 1);
+    append_decimal_recursive(magnitude, k, 0, base10);
     return base10;
 }
 
 // convert number to decimal string by converting from binary to BCD, then BCD to decimal - complexity O(n^2), n is # of bits
 std::string BigInt::to_string2() const {
+    BIGINT_STAT_SCOPE(TO_STRING2, num_digits());
     // an n-bit binary number has at most d = nlog10(2) + 1 decimal digits, so reserve 4d bits for bcd representation
     const size_t num_digits = this->num_digits();
-    std::vector<uint> bcd((BITS_IN_NIBBLE * (log10(2) * num_digits * BITS_IN_UINT + 1)) / BITS_IN_UINT + 1, 0);
+    std::vector<uint> bcd((BITS_IN_NIBBLE * (log10(2) * num_digits * BITS_IN_LIMB + 1)) / BITS_IN_UINT + 1, 0);
 
     // perform double-dabble algorithm to convert *this from binary to BCD
-    for (size_t i = num_digits; i-- > 0;) { // for each uint digit in this BigInt's digits (going from MSD -> LSD)
-        uint digit = this->digits[i];
+    for (size_t i = num_digits; i-- > 0;) { // for each limb digit in this BigInt's digits (going from MSD -> LSD)
+        limb digit = this->digits[i];
 
-        uint bit_iters = 0;                                                       // want to keep track of how many bits we've iterated through on current uint digit to shift down to LSB after masking
-        for (uint mask = 1 << (BITS_IN_UINT - 1); mask > 0; mask >>= 1) {         // for each bit in digit (going from MSB -> LSB)
-            uint insert_bit = (digit & mask) >> (BITS_IN_UINT - 1 - bit_iters++); // grab bit, shift down to LSB
+        uint bit_iters = 0;                                                              // want to keep track of how many bits we've iterated through on current limb digit to shift down to LSB after masking
+        for (limb mask = (limb)1 << (BITS_IN_LIMB - 1); mask > 0; mask >>= 1) {         // for each bit in digit (going from MSB -> LSB)
+            uint insert_bit = (uint)((digit & mask) >> (BITS_IN_LIMB - 1 - bit_iters++)); // grab bit, shift down to LSB
 
             for (size_t j = bcd.size(); j-- > 0;) {                                           // for each bcd byte
                 if (bcd[j] != 0) {                                                                  // dabble if bcd[j] is non-zero
@@ -191,24 +504,208 @@ std::string BigInt::to_string2() const {
 }
 
 // get list of digits
-std::vector<uint> BigInt::get_digits() const {
-    return this->digits;
+std::vector<limb> BigInt::get_digits() const {
+    return std::vector<limb>(this->digits.begin(), this->digits.end());
+}
+
+namespace {
+const std::byte BINARY_MAGIC[4] = { std::byte{ 'B' }, std::byte{ 'I' }, std::byte{ 'G' }, std::byte{ 'I' } };
+const std::byte BINARY_VERSION{ 1 };
+const std::byte BINARY_NEGATIVE{ 1 }; // flags bit
+const size_t BINARY_HEADER_BYTES = 16;
+const size_t BINARY_WORD_BYTES = 8;
+const size_t LIMBS_IN_WORD = BINARY_WORD_BYTES / sizeof(limb);
+// read_binary's step, so a corrupt length runs into the end of the stream instead of allocating all of it up front
+const size_t READ_CHUNK_WORDS = (size_t)1 << 16;
+constexpr bool LITTLE_ENDIAN_HOST = std::endian::native == std::endian::little;
+
+struct BinaryHeader {
+    uint64_t words;
+    bool negative;
+};
+
+// 64-bit words the binary format needs for magnitude
+size_t binary_words(std::span<const limb> magnitude) {
+    size_t n = magnitude.size();
+    while (n > 0 && magnitude[n - 1] == 0) {
+        --n;
+    }
+    return (n * sizeof(limb) + BINARY_WORD_BYTES - 1) / BINARY_WORD_BYTES;
+}
+
+std::array<std::byte, BINARY_HEADER_BYTES> binary_header(uint64_t words, bool negative) {
+    std::array<std::byte, BINARY_HEADER_BYTES> header{};
+    std::copy(std::begin(BINARY_MAGIC), std::end(BINARY_MAGIC), header.begin());
+    header[4] = BINARY_VERSION;
+    header[5] = negative ? BINARY_NEGATIVE : std::byte{ 0 };
+    for (size_t i = 0; i < 8; ++i) {
+        header[8 + i] = (std::byte)(words >> (BITS_IN_BYTE * i));
+    }
+    return header;
+}
+
+// false unless data starts with a header binary_header could have written
+bool read_binary_header(std::span<const std::byte> data, BinaryHeader &header) {
+    if (data.size() < BINARY_HEADER_BYTES || !std::equal(std::begin(BINARY_MAGIC), std::end(BINARY_MAGIC), data.begin()) ||
+        data[4] != BINARY_VERSION || (data[5] & ~BINARY_NEGATIVE) != std::byte{ 0 } || data[6] != std::byte{ 0 } ||
+        data[7] != std::byte{ 0 }) {
+        return false;
+    }
+    header.words = 0;
+    for (size_t i = 8; i-- > 0;) {
+        header.words = header.words << BITS_IN_BYTE | (uint64_t)data[8 + i];
+    }
+    header.negative = data[5] == BINARY_NEGATIVE;
+    return true;
+}
+
+// false if the magnitude has a zero word on top or is a negative zero, which write_binary never produces
+bool canonical_magnitude(std::span<const limb> magnitude, bool negative) {
+    if (magnitude.empty()) {
+        return !negative;
+    }
+    return std::any_of(magnitude.end() - LIMBS_IN_WORD, magnitude.end(), [](limb x) { return x != 0; });
+}
+
+// turns limbs in native byte order into little-endian ones and back, nothing to do on little-endian hosts
+void swap_limb_bytes(std::span<std::byte> bytes) {
+    if (!LITTLE_ENDIAN_HOST) {
+        for (size_t i = 0; i < bytes.size(); i += sizeof(limb)) {
+            std::reverse(bytes.begin() + i, bytes.begin() + i + sizeof(limb));
+        }
+    }
+}
+
+// the magnitude of the number at the start of data, throws std::invalid_argument if there is none
+std::span<const std::byte> binary_payload(std::span<const std::byte> data, BinaryHeader &header) {
+    if (!read_binary_header(data, header)) {
+        throw std::invalid_argument("BigInt: not a number in binary format");
+    }
+    if (header.words > (data.size() - BINARY_HEADER_BYTES) / BINARY_WORD_BYTES) {
+        throw std::invalid_argument("BigInt: binary data cut short");
+    }
+    return data.subspan(BINARY_HEADER_BYTES, header.words * BINARY_WORD_BYTES);
+}
+} // namespace
+
+std::span<const limb> BigInt::limbs() const {
+    return std::span<const limb>(digits.data(), digits.size());
+}
+
+size_t BigInt::binary_size() const {
+    return BINARY_HEADER_BYTES + binary_words(limbs()) * BINARY_WORD_BYTES;
+}
+
+// the header, then the limbs' bytes padded with zeros to whole words
+std::vector<std::byte> BigInt::to_binary() const {
+    const size_t words = binary_words(limbs());
+    const std::array<std::byte, BINARY_HEADER_BYTES> header = binary_header(words, !positive);
+    std::vector<std::byte> data(BINARY_HEADER_BYTES + words * BINARY_WORD_BYTES);
+    std::copy(header.begin(), header.end(), data.begin());
+    const std::span<std::byte> payload = std::span<std::byte>(data).subspan(BINARY_HEADER_BYTES);
+    const std::byte *limb_bytes = reinterpret_cast<const std::byte *>(digits.data());
+    std::copy_n(limb_bytes, std::min(payload.size(), digits.size() * sizeof(limb)), payload.begin());
+    swap_limb_bytes(payload);
+    return data;
+}
+
+// on little-endian hosts the limbs go to the stream as they are, with no intermediate buffer
+void BigInt::write_binary(std::ostream &out) const {
+    if (!LITTLE_ENDIAN_HOST) {
+        const std::vector<std::byte> data = to_binary();
+        out.write(reinterpret_cast<const char *>(data.data()), (std::streamsize)data.size());
+        return;
+    }
+    const size_t words = binary_words(limbs());
+    const std::array<std::byte, BINARY_HEADER_BYTES> header = binary_header(words, !positive);
+    const size_t limb_bytes = std::min(words * BINARY_WORD_BYTES, digits.size() * sizeof(limb));
+    const char padding[BINARY_WORD_BYTES] = {};
+    out.write(reinterpret_cast<const char *>(header.data()), (std::streamsize)header.size());
+    out.write(reinterpret_cast<const char *>(digits.data()), (std::streamsize)limb_bytes);
+    out.write(padding, (std::streamsize)(words * BINARY_WORD_BYTES - limb_bytes));
+}
+
+BigInt BigInt::from_binary(std::span<const std::byte> data) {
+    BinaryHeader header;
+    const std::span<const std::byte> payload = binary_payload(data, header);
+    if (header.words == 0) {
+        if (header.negative) {
+            throw std::invalid_argument("BigInt: malformed binary data");
+        }
+        return BigInt();
+    }
+    digit_vector magnitude(header.words * LIMBS_IN_WORD);
+    const std::span<std::byte> magnitude_bytes(reinterpret_cast<std::byte *>(magnitude.data()), payload.size());
+    std::copy(payload.begin(), payload.end(), magnitude_bytes.begin());
+    swap_limb_bytes(magnitude_bytes);
+    if (!canonical_magnitude(std::span<const limb>(magnitude.data(), magnitude.size()), header.negative)) {
+        throw std::invalid_argument("BigInt: malformed binary data");
+    }
+    return BigInt(std::move(magnitude), !header.negative);
+}
+
+// the words of a little-endian payload are limbs already, so the view points at them. with 32-bit limbs the top
+// word may end in a zero limb, which is left out
+BinaryView BigInt::view_binary(std::span<const std::byte> data) {
+    BinaryHeader header;
+    const std::span<const std::byte> payload = binary_payload(data, header);
+    if (!LITTLE_ENDIAN_HOST) {
+        throw std::invalid_argument("BigInt: binary data can only be viewed in place on little-endian hosts");
+    }
+    if (reinterpret_cast<uintptr_t>(payload.data()) % alignof(limb) != 0) {
+        throw std::invalid_argument("BigInt: binary data is not aligned for viewing in place");
+    }
+    std::span<const limb> magnitude(reinterpret_cast<const limb *>(payload.data()), header.words * LIMBS_IN_WORD);
+    if (!canonical_magnitude(magnitude, header.negative)) {
+        throw std::invalid_argument("BigInt: malformed binary data");
+    }
+    if (!magnitude.empty() && magnitude.back() == 0) {
+        magnitude = magnitude.first(magnitude.size() - 1);
+    }
+    return BinaryView{ magnitude, header.negative, BINARY_HEADER_BYTES + payload.size() };
+}
+
+// reads the words straight into the limbs, READ_CHUNK_WORDS at a time
+BigInt BigInt::read_binary(std::istream &in) {
+    std::array<std::byte, BINARY_HEADER_BYTES> header_bytes;
+    BinaryHeader header;
+    if (!in.read(reinterpret_cast<char *>(header_bytes.data()), (std::streamsize)header_bytes.size()) ||
+        !read_binary_header(header_bytes, header)) {
+        in.setstate(std::ios_base::failbit);
+        return BigInt();
+    }
+    digit_vector magnitude;
+    for (uint64_t words_read = 0; words_read < header.words;) {
+        const size_t chunk = (size_t)std::min<uint64_t>(header.words - words_read, READ_CHUNK_WORDS);
+        magnitude.resize((size_t)(words_read + chunk) * LIMBS_IN_WORD);
+        if (!in.read(reinterpret_cast<char *>(magnitude.data() + words_read * LIMBS_IN_WORD), (std::streamsize)(chunk * BINARY_WORD_BYTES))) {
+            in.setstate(std::ios_base::failbit);
+            return BigInt();
+        }
+        words_read += chunk;
+    }
+    swap_limb_bytes(std::span<std::byte>(reinterpret_cast<std::byte *>(magnitude.data()), magnitude.size() * sizeof(limb)));
+    if (!canonical_magnitude(std::span<const limb>(magnitude.data(), magnitude.size()), header.negative)) {
+        in.setstate(std::ios_base::failbit);
+        return BigInt();
+    }
+    return magnitude.empty() ? BigInt() : BigInt(std::move(magnitude), !header.negative);
 }
 
 // return a boolean array containing the bits of your number
 // ex: get_bits(15, false) == vector<bool>({ 1, 1, 1, 1 })  <== true
-std::vector<bool> BigInt::get_bits(uint num, bool pad_uint) {
+std::vector<bool> BigInt::get_bits(limb num, bool pad_limb) {
     std::vector<bool> res_bits;
-    res_bits.reserve(BITS_IN_UINT);
+    res_bits.reserve(BITS_IN_LIMB);
 
-    uint mask = 1;
+    limb mask = 1;
     while (num > 0) {
         res_bits.push_back(num & mask); //grab last bit of num
         num >>= 1;                      // shift num right 1 bit, now what was the second to last bit is last bit
     }
 
-    if (pad_uint) { // pad vector with 0s if we want 32-bit number
-        for (size_t i = res_bits.size(); i < BITS_IN_UINT; ++i) {
+    if (pad_limb) { // pad vector with 0s if we want a full limb
+        for (size_t i = res_bits.size(); i < BITS_IN_LIMB; ++i) {
             res_bits.push_back(0);
         }
     }
@@ -216,232 +713,1102 @@ std::vector<bool> BigInt::get_bits(uint num, bool pad_uint) {
     return res_bits;
 }
 
-// return a boolean array containing the bits of your BigInt
-//		this is done by calling above function for each uint digit
-//		and iteratively prepending their bit vectors
+// return a boolean array containing the bits of your BigInt, least significant first, without leading zeros
 std::vector<bool> BigInt::get_bits() const {
-    std::vector<bool> res_bits;
-    size_t my_size = this->num_digits();
-    res_bits.reserve(BITS_IN_UINT * my_size);
-
-    for (size_t i = 0; i < my_size; ++i) {
-        std::vector<bool> bit_block_32 = get_bits(this->digits[i], (i < my_size - 1));
-        res_bits.insert(res_bits.end(), bit_block_32.begin(), bit_block_32.end());
+    std::vector<bool> res_bits(bit_length());
+    for (size_t i = 0; i < res_bits.size(); ++i) {
+        res_bits[i] = (digits[i / BITS_IN_LIMB] >> (i % BITS_IN_LIMB)) & 1;
     }
-
     return res_bits;
 }
 
-// get number of base 2^32 (BASE) digits in BigInt
+// get number of base 2^32 or 2^64 (BASE) digits in BigInt
 size_t BigInt::num_digits() const {
     return this->digits.size();
 }
 
-// adds two BigInts with like signs (i.e. a+b where a,b >= 0 OR a,b < 0), complexity O(n)
-BigInt BigInt::add_like_signs(const BigInt &a, const BigInt &b) {
-    std::vector<uint> result_digits;
-    size_t a_num_digits = a.num_digits();
-    size_t b_num_digits = b.num_digits();
-    result_digits.reserve(std::max(a_num_digits, b_num_digits) + 1);
+size_t BigInt::popcount() const {
+    size_t count = 0;
+    for (limb digit : digits) {
+        count += std::popcount(digit);
+    }
+    return count;
+}
+
+// adds the magnitudes of two BigInts (i.e. a+b where a,b >= 0 OR a,b < 0), result gets the given sign, complexity O(n)
+BigInt BigInt::add_like_signs(const BigInt &a, const BigInt &b, bool positive) {
+    const BigInt *longer = &a;
+    const BigInt *shorter = &b;
+    if (longer->num_digits() < shorter->num_digits()) {
+        std::swap(longer, shorter);
+    }
+    const size_t n = longer->num_digits();
+    digit_vector result_digits(n + 1);
+    result_digits[n] = mpn::add(std::span<limb>(result_digits).first(n), longer->digits, shorter->digits);
+    return BigInt(std::move(result_digits), positive);
+}
+
+// subtracts the magnitudes of two BigInts where |big| >= |small|, result gets the given sign, complexity O(n)
+BigInt BigInt::add_diff_signs(const BigInt &big, const BigInt &small, bool positive) {
+    digit_vector result_digits(big.num_digits());
+    mpn::sub(result_digits, big.digits, small.digits);
+    return BigInt(std::move(result_digits), positive); // constructor strips zero-digits in MSB positions
+}
+
+// returns a + b where b's sign is taken to be b_positive, so subtraction needs no negated copy of b
+BigInt BigInt::add_signed(const BigInt &a, const BigInt &b, bool b_positive) {
+    // same sign
+    if (a.positive == b_positive) {
+        return add_like_signs(a, b, b_positive);
+    }
+
+    // diff signs, want to send higher mag BigNum as first arg
+    if (compare_magnitudes(a, b) < 0) {
+        return add_diff_signs(b, a, b_positive);
+    }
+    return add_diff_signs(a, b, a.positive);
+}
+
+// returns *this * 2^bits as a single-term LinearSum
+LinearSum<1> BigInt::scaled(size_t bits) const& {
+    return LinearSum<1>{{SumTerm{std::span<const limb>(digits.data(), digits.size()), !positive, bits}}};
+}
+
+// returns *this * 2^bits, shifted in this temporary's own storage
+BigInt BigInt::scaled(size_t bits) && {
+    *this <<= bits;
+    return std::move(*this);
+}
+
+// *this = the sum of terms, accumulated into this BigInt's own digit storage in two's complement: each term is
+// added or subtracted in place at its limb offset with the limb kernels, carries and borrows out of the top are
+// dropped, and a negative total (top bit set) is negated at the end. a term shifted by a non-multiple of
+// BITS_IN_LIMB is shifted into a copy first. complexity O(n * terms.size())
+void BigInt::assign_sum(std::span<const SumTerm> terms) {
+    size_t n = 0;
+    for (const SumTerm &term : terms) {
+        n = std::max(n, term.magnitude.size() + (term.shift + BITS_IN_LIMB - 1) / BITS_IN_LIMB);
+        const limb *data = term.magnitude.data();
+        if (data >= digits.data() && data < digits.data() + digits.size()) { // would overwrite a term while reading it
+            BigInt result;
+            result.assign_sum(terms);
+            *this = std::move(result);
+            return;
+        }
+    }
+    BIGINT_STAT_SCOPE(SUM, n);
+    // |total| < terms.size() * BASE^n, so one extra limb holds it with room for the sign bit
+    digits.resize(n + 1);
+    const std::span<limb> total(digits.data(), n + 1);
+    digit_vector shifted;
+    bool started = false;
+    for (const SumTerm &term : terms) {
+        std::span<const limb> magnitude = term.magnitude;
+        if (term.shift % BITS_IN_LIMB) {
+            shifted.resize(magnitude.size() + 1);
+            shifted[magnitude.size()] = mpn::lshift(std::span<limb>(shifted).first(magnitude.size()), magnitude, term.shift % BITS_IN_LIMB);
+            magnitude = std::span<const limb>(shifted.data(), shifted.size());
+        }
+        const std::span<limb> window = total.subspan(term.shift / BITS_IN_LIMB);
+        if (!started) { // a positive first term is copied in rather than added to zeros
+            started = true;
+            if (!term.negative) {
+                std::fill(total.begin(), window.begin(), 0);
+                std::fill(std::copy(magnitude.begin(), magnitude.end(), window.begin()), total.end(), 0);
+                continue;
+            }
+            std::fill(total.begin(), total.end(), 0);
+        }
+        if (term.negative) {
+            mpn::sub(window, window, magnitude);
+        } else {
+            mpn::add(window, window, magnitude);
+        }
+    }
+    positive = total[n] >> (BITS_IN_LIMB - 1) == 0;
+    if (!positive) { // two's complement negate: invert and add one
+        for (limb &d : total) {
+            d = ~d;
+        }
+        mpn::add_1(total, total, 1);
+    }
+    trim();
+}
+
+// *this += b where b's sign is taken to be b_positive, reuses this BigInt's digit storage
+void BigInt::add_in_place(const BigInt &b, bool b_positive) {
+    if (&b == this) { // would read b's digits while resizing them
+        *this = add_signed(*this, b, b_positive);
+        return;
+    }
+    const size_t n = num_digits();
+    const size_t b_n = b.num_digits();
+    if (positive == b_positive) {
+        digits.resize(std::max(n, b_n) + 1, 0);
+        const std::span<limb> sum = std::span<limb>(digits).first(digits.size() - 1);
+        if (n >= b_n) {
+            digits.back() = mpn::add(sum, sum, b.digits);
+        } else {
+            digits.back() = mpn::add(sum, b.digits, std::span<const limb>(sum).first(n));
+        }
+    } else if (compare_magnitudes(*this, b) >= 0) {
+        mpn::sub(digits, digits, b.digits);
+    } else {
+        digits.resize(b_n, 0);
+        mpn::sub(digits, b.digits, std::span<const limb>(digits).first(n));
+        positive = b_positive;
+    }
+    trim();
+}
+
+// returns base^exponent, exponent must not be negative
+BigInt BigInt::pow(const BigInt &base, const BigInt &exponent) {
+    if (!exponent.positive) {
+        throw std::domain_error("BigInt: negative exponent");
+    }
+    return pow_digits(base, exponent.digits);
+}
 
-    size_t i = 0;
-    size_t j = 0;
-    ulonglong overflow = 0;
-    while (i < a_num_digits && j < b_num_digits) { // add a's and b's digits pair-wise + carry
-        ulonglong true_add = (ulonglong)a.digits[i++] + b.digits[j++] + overflow;
-        uint new_digit = (uint)true_add;     // gives result mod BASE
-        overflow = true_add >> BITS_IN_UINT; // 1 if true_add > BASE - 1 else 0
-        result_digits.push_back(new_digit);
+// returns base^exponent
+BigInt BigInt::pow(const BigInt &base, ulonglong exponent) {
+    digit_vector exponent_digits;
+    for (size_t i = 0; i < ULONGLONG_BYTES / sizeof(limb); ++i) {
+        exponent_digits.push_back((limb)(exponent >> (i * BITS_IN_LIMB)));
+    }
+    return pow_digits(base, exponent_digits);
+}
+
+// returns base^exponent for the exponent's magnitude digits (top ones may be zero). base = odd * 2^k is split so
+// only the odd part goes through the multiplications, the 2^(k*exponent) is a shift at the end (all of the work
+// when the base is a power of two). the odd part is raised left to right: the exponent is scanned from its top bit,
+// squaring once per bit and multiplying by the odd part at each set bit, so every multiplication has the short
+// operand on one side. a sliding window would save some of those multiplications, but its precomputed powers
+// odd^3, odd^5, ... are longer than the odd part by the same factor, which makes each window's product cost more
+// than the ones it replaces when the numbers grow with every step
+BigInt BigInt::pow_digits(const BigInt &base, const digit_vector &exponent) {
+    BIGINT_STAT_SCOPE(POW, base.num_digits());
+    size_t exponent_bits = 0;
+    for (size_t i = exponent.size(); i-- > 0;) {
+        if (exponent[i] != 0) {
+            exponent_bits = i * BITS_IN_LIMB + (BITS_IN_LIMB - std::countl_zero(exponent[i]));
+            break;
+        }
+    }
+    if (exponent_bits == 0) {
+        return BigInt(1);
     }
+    if (base == 0) {
+        return BigInt();
+    }
+    const auto bit = [&](size_t i) { return (exponent[i / BITS_IN_LIMB] >> (i % BITS_IN_LIMB)) & 1; };
+    const bool negative = !base.positive && bit(0);
 
-    // b had less digits than a.
-    // iterate through remainder of a's digits, adding possible carries
-    while (i < a_num_digits) {
-        ulonglong true_add = (ulonglong)a.digits[i++] + overflow;
-        uint new_digit = (uint)true_add;     // gives result mod BASE
-        overflow = true_add >> BITS_IN_UINT; // 1 if true_add > BASE - 1 else 0
-        result_digits.push_back(new_digit);
+    size_t k = 0;
+    while (base.digits[k / BITS_IN_LIMB] == 0) {
+        k += BITS_IN_LIMB;
+    }
+    k += std::countr_zero(base.digits[k / BITS_IN_LIMB]);
+    const BigInt odd = base.shifted_right(k);
+
+    BigInt power(1);
+    if (odd != 1) {
+        power = odd;
+        for (size_t i = exponent_bits - 1; i-- > 0;) {
+            power = power.square();
+            if (bit(i)) {
+                power = power * odd;
+            }
+        }
+    }
+    if (k > 0) {
+        size_t e = 0;
+        for (size_t i = 0; i * BITS_IN_LIMB < exponent_bits && i * BITS_IN_LIMB < std::numeric_limits<size_t>::digits; ++i) {
+            e |= (size_t)exponent[i] << (i * BITS_IN_LIMB);
+        }
+        if (exponent_bits > std::numeric_limits<size_t>::digits || e > std::numeric_limits<size_t>::max() / k) {
+            throw std::length_error("BigInt: power too large");
+        }
+        power = power.shifted_left(k * e);
     }
+    power.positive = !negative;
+    return power;
+}
+
+// multiplies the magnitudes of a and b with the fastest algorithm for their sizes
+BigInt BigInt::mult(const BigInt &a, const BigInt &b) {
+    BIGINT_STAT_SCOPE(MUL, std::max(a.num_digits(), b.num_digits()));
+    digit_vector result_digits(a.num_digits() + b.num_digits());
+    mpn::mul(result_digits, a.digits, b.digits);
+    return BigInt(std::move(result_digits), true);
+}
+
+// returns *this * *this, squaring needs about half the partial products of a general multiplication
+BigInt BigInt::square() const {
+    BIGINT_STAT_SCOPE(SQR, num_digits());
+    digit_vector result_digits(2 * num_digits());
+    mpn::sqr(result_digits, digits);
+    return BigInt(std::move(result_digits), true);
+}
 
-    // a had less digits than b.
-    // iterate through remainder of b's digits, adding possible carries
-    while (j < b_num_digits) {
-        ulonglong true_add = (ulonglong)b.digits[j++] + overflow;
-        uint new_digit = (uint)true_add;     // gives result mod BASE
-        overflow = true_add >> BITS_IN_UINT; // 1 if true_add > BASE - 1 else 0
-        result_digits.push_back(new_digit);
+// divides |a| by |b|: normalizes them and lets mpn::divrem pick Knuth's algorithm D (gradeschool long division,
+// O(m*n)) or Burnikel-Ziegler recursive division (O(M(n) log n)) for the sizes
+void BigInt::long_div(const BigInt &a, const BigInt &b, BigInt &quotient, BigInt &remainder) {
+    const size_t m = a.num_digits();
+    const size_t n = b.num_digits();
+    if (compare_magnitudes(a, b) < 0) {
+        quotient = BigInt();
+        remainder = BigInt(a.digits, true);
+        return;
     }
 
-    // take care of possible remaining carry
-    if (overflow) {
-        result_digits.push_back((uint)overflow);
+    digit_vector q(m - n + 1, 0);
+    if (n == 1) { // single digit divisor, one pass from MSD -> LSD carrying the running remainder
+        const limb rem = mpn::divrem_1(q, a.digits, b.digits[0]);
+        quotient = BigInt(std::move(q), true);
+        remainder = BigInt(digit_vector(1, rem), true);
+        return;
     }
 
-    return BigInt(result_digits, a.positive);
+    // normalize so the divisor's top bit is set, this keeps each estimated quotient digit within 2 of the real one
+    const unsigned s = std::countl_zero(b.digits[n - 1]);
+    digit_vector v(n), u(m + 1);
+    mpn::lshift(v, b.digits, s);
+    u[m] = mpn::lshift(std::span<limb>(u).first(m), a.digits, s);
+    mpn::divrem(q, u, v);
+
+    quotient = BigInt(std::move(q), true);
+    u.resize(n);
+    mpn::rshift(u, u, s);
+    remainder = BigInt(std::move(u), true);
 }
 
-// adds two BigInts with different signs, complexity O(n)
-BigInt BigInt::add_diff_signs(const BigInt &big, const BigInt &small) {
-    std::vector<uint> result_digits;
-    size_t big_num_digits = big.num_digits();
-    size_t small_num_digits = small.num_digits();
-    result_digits.reserve(small_num_digits + 1);
+// computes quotient = a / b (truncated toward zero) and remainder = a - quotient * b, remainder takes the sign of a
+void BigInt::divmod(const BigInt &a, const BigInt &b, BigInt &quotient, BigInt &remainder) {
+    if (b == 0) {
+        throw std::domain_error("BigInt division by zero");
+    }
+    BIGINT_STAT_SCOPE(DIV, a.num_digits());
+    const bool quotient_positive = a.positive == b.positive;
+    const bool remainder_positive = a.positive;
+    long_div(a, b, quotient, remainder);
+    quotient.positive = quotient_positive;
+    remainder.positive = remainder_positive;
+    quotient.trim();
+    remainder.trim();
+}
 
-    size_t i = 0;
-    size_t j = 0;
-    uint underflow = 0;
-    while (i < big_num_digits && j < small_num_digits) {              // iterate pairwise through a's and b's digits, subtracting - underflow
-        uint new_digit = big.digits[i] - small.digits[j] - underflow; // gives result mod BASE
-        //underflow = (big.digits[i++] < small.digits[j++]) ? 1 : 0;
-        underflow = (bool)(small.digits[j++] / big.digits[i++]);
-        result_digits.push_back(new_digit);
+namespace {
+const size_t PRODUCT_LEAF_LIMBS = 16; // product_of_small packs its factors into numbers of about this many limbs
+
+// the primes <= n, in increasing order. sieves the odd numbers only
+std::vector<ulonglong> primes_up_to(ulonglong n) {
+    std::vector<ulonglong> primes;
+    if (n < 2) {
+        return primes;
+    }
+    primes.push_back(2);
+    std::vector<bool> composite((n - 1) / 2); // composite[i] is 2 * i + 3
+    for (ulonglong i = 0; i < composite.size(); ++i) {
+        if (composite[i]) {
+            continue;
+        }
+        const ulonglong p = 2 * i + 3;
+        primes.push_back(p);
+        for (ulonglong j = (p * p - 3) / 2; p <= n / p && j < composite.size(); j += p) {
+            composite[j] = true;
+        }
+    }
+    return primes;
+}
+} // namespace
+
+// the product of factors: runs of them are multiplied into a limb, those limbs into leaves of about
+// PRODUCT_LEAF_LIMBS limbs with single-limb multiplications, and the leaves go through product()
+BigInt BigInt::product_of_small(std::span<const ulonglong> factors) {
+    std::vector<BigInt> leaves;
+    digit_vector leaf(1, 1);
+    limb run = 1;
+    const auto flush_run = [&] {
+        const limb carry = mpn::mul_1(leaf, leaf, run);
+        if (carry != 0) {
+            leaf.push_back(carry);
+        }
+        run = 1;
+        if (leaf.size() >= PRODUCT_LEAF_LIMBS) {
+            leaves.push_back(BigInt(std::move(leaf), true));
+            leaf = digit_vector(1, 1);
+        }
+    };
+    for (ulonglong factor : factors) {
+        if (factor == 0) {
+            return BigInt();
+        }
+        if (factor > _LIMB_MAX) { // only with 32-bit limbs, the factor is a leaf of its own
+            digit_vector wide;
+            for (size_t i = 0; i < ULONGLONG_BYTES / sizeof(limb); ++i) {
+                wide.push_back((limb)(factor >> (i * BITS_IN_LIMB)));
+            }
+            BigInt wide_leaf(std::move(wide), true);
+            wide_leaf.trim();
+            leaves.push_back(std::move(wide_leaf));
+            continue;
+        }
+        if ((dlimb)run * factor > _LIMB_MAX) {
+            flush_run();
+        }
+        run *= (limb)factor;
     }
+    flush_run();
+    if (leaf.size() > 1 || leaf[0] != 1) {
+        leaves.push_back(BigInt(std::move(leaf), true));
+    }
+    return product(leaves);
+}
 
-    // finish off subtracting underflow from big's remaining digits
-    while (i < big_num_digits) {
-        uint new_digit = big.digits[i++] - underflow; // gives result mod BASE
-        underflow = 0;
-        result_digits.push_back(new_digit);
+// where to split two or more factors for a balanced product: the first index of the right half, chosen so the
+// limbs on both sides come closest to half the total. ProductTree splits the same way
+size_t BigInt::product_split(std::span<const BigInt> factors) {
+    size_t total = 0;
+    for (const BigInt &factor : factors) {
+        total += factor.num_digits();
     }
+    size_t split = 1, left = factors[0].num_digits();
+    while (split + 1 < factors.size() && 2 * (left + factors[split].num_digits()) <= total) {
+        left += factors[split++].num_digits();
+    }
+    return split;
+}
 
-    // finish off subtracting underflow from small's remaining digits
-    while (j < small_num_digits) {
-        uint new_digit = small.digits[j++] - underflow; // gives result mod BASE
-        underflow = 0;
-        result_digits.push_back(new_digit);
+// returns the product of factors, as the root of a tree split by product_split
+BigInt BigInt::product(std::span<const BigInt> factors) {
+    if (factors.empty()) {
+        return BigInt(1);
     }
+    if (factors.size() == 1) {
+        return factors[0];
+    }
+    if (factors.size() == 2) {
+        return factors[0] * factors[1];
+    }
+    const size_t split = product_split(factors);
+    return product(factors.first(split)) * product(factors.subspan(split));
+}
 
-    // remove possible zero-digits in MSB positions from result
-    for (size_t ind = result_digits.size(); ind-- > 0;) {
-        if (result_digits[ind] != 0) {
-            result_digits.resize(ind + 1);
+// the odd part of n!, with n! = (n/2)!^2 * swing(n) where the swing n! / (n/2)!^2 has each prime p to the power
+// sum over i >= 1 of floor(n / p^i) mod 2, so it is a product of small factors. primes holds at least those <= n
+BigInt BigInt::odd_factorial(ulonglong n, std::span<const ulonglong> primes) {
+    if (n < 3) {
+        return BigInt(1);
+    }
+    std::vector<ulonglong> swing;
+    for (size_t i = 1; i < primes.size() && primes[i] <= n; ++i) {
+        const ulonglong p = primes[i];
+        for (ulonglong q = n / p; q > 0; q /= p) {
+            if (q & 1) {
+                swing.push_back(p);
+            }
+        }
+    }
+    return odd_factorial(n / 2, primes).square() * product_of_small(swing);
+}
+
+// returns n!, the odd part by the prime swing and the power of two, 2^(n - popcount(n)), as a shift
+BigInt BigInt::factorial(ulonglong n) {
+    const std::vector<ulonglong> primes = primes_up_to(n);
+    return odd_factorial(n, primes) << (size_t)(n - std::popcount(n));
+}
+
+// returns n choose k. for k <= n / 16 as n (n-1) ... (n-k+1) / k!, otherwise from the primes p <= n, which divide
+// the result p^e times where e = sum over i >= 1 of floor(n / p^i) - floor(k / p^i) - floor((n-k) / p^i)
+BigInt BigInt::binomial(ulonglong n, ulonglong k) {
+    if (k > n) {
+        return BigInt();
+    }
+    k = std::min(k, n - k);
+    if (k <= n / 16) {
+        std::vector<ulonglong> falling(k);
+        for (ulonglong i = 0; i < k; ++i) {
+            falling[i] = n - i;
+        }
+        return product_of_small(falling) / factorial(k);
+    }
+    std::vector<ulonglong> factors;
+    for (ulonglong p : primes_up_to(n)) {
+        for (ulonglong q = p;; q *= p) {
+            for (ulonglong e = n / q - k / q - (n - k) / q; e > 0; --e) {
+                factors.push_back(p);
+            }
+            if (q > n / p) {
+                break;
+            }
+        }
+    }
+    return product_of_small(factors);
+}
+
+// returns the product of the primes <= n
+BigInt BigInt::primorial(ulonglong n) {
+    return product_of_small(primes_up_to(n));
+}
+
+namespace {
+// the cofactors of a Lehmer step (Knuth's algorithm L): it takes (u, v) to (A u + B v, C u + D v), where
+// A, D >= 0 >= B, C after an even number of quotients and A, D <= 0 <= B, C after an odd one. a, b, c, d are their
+// magnitudes, which are kept to a limb
+struct LehmerStep {
+    limb a = 1, b = 0, c = 0, d = 1;
+    bool odd = false;
+};
+
+// runs euclid's algorithm on uh >= vh, the same 2 * BITS_IN_LIMB - 1 top bits of u >= v, for as long as the
+// quotients are certain to be those of u and v: (uh + A) / (vh + C) and (uh + B) / (vh + D) bracket the quotient of
+// the numbers themselves, a quotient is only taken where both give it. b is 0 if not even the first one was certain
+LehmerStep lehmer_step(dlimb uh, dlimb vh) {
+    const dlimb LIMB_MASK = std::numeric_limits<limb>::max();
+    LehmerStep step;
+    while (true) {
+        dlimb num1, den1, num2, den2;
+        if (!step.odd) {
+            if (vh <= step.c || uh < step.b) {
+                break;
+            }
+            num1 = uh + step.a, den1 = vh - step.c, num2 = uh - step.b, den2 = vh + step.d;
+        } else {
+            if (vh <= step.d || uh < step.a) {
+                break;
+            }
+            num1 = uh - step.a, den1 = vh + step.c, num2 = uh + step.b, den2 = vh - step.d;
+        }
+        const dlimb q = num1 / den1;
+        if (q != num2 / den2 || q > LIMB_MASK) {
+            break;
+        }
+        const dlimb c = step.a + q * step.c, d = step.b + q * step.d;
+        if (c > LIMB_MASK || d > LIMB_MASK) {
             break;
         }
+        step = LehmerStep{ step.c, step.d, (limb)c, (limb)d, !step.odd };
+        const dlimb r = uh - q * vh;
+        uh = vh;
+        vh = r;
     }
+    return step;
+}
 
-    return BigInt(result_digits, big.positive);
+// bits [shift, shift + 2 * BITS_IN_LIMB) of x, zero past its end
+dlimb top_bits(std::span<const limb> x, size_t shift) {
+    const size_t i = shift / BITS_IN_LIMB, r = shift % BITS_IN_LIMB;
+    const auto at = [&](size_t j) -> dlimb { return j < x.size() ? x[j] : 0; };
+    const dlimb bits = at(i) | at(i + 1) << BITS_IN_LIMB;
+    return r == 0 ? bits : bits >> r | at(i + 2) << (2 * BITS_IN_LIMB - r);
 }
 
-// return base^exponent
-BigInt BigInt::pow(const BigInt &base, const BigInt &exponent) {
-    if (exponent == 1) {
-        return base;
+// r = x * p - y * q, which the caller knows to lie in [0, BASE^n) for n = r.size() = x.size() = y.size(), so the
+// limbs the products have above n cancel
+void mul_1_sub_mul_1(std::span<limb> r, std::span<const limb> x, limb p, std::span<const limb> y, limb q) {
+    mpn::mul_1(r, x, p);
+    mpn::submul_1(r, y, q);
+}
+} // namespace
+
+// the quotients of a gcd reduction as one matrix: the pair before the reduction is m times the pair after it. every
+// quotient q multiplies it by [[q, 1], [1, 0]] from the right. det is its determinant, 1 or -1, steps counts what
+// was multiplied in (0 for the identity)
+struct BigInt::GcdMatrix {
+    BigInt m[2][2] = { { 1, 0 }, { 0, 1 } };
+    int det = 1;
+    size_t steps = 0;
+
+    // *this = *this * [[q, 1], [1, 0]]
+    void push_quotient(const BigInt &q) {
+        for (BigInt *row : { m[0], m[1] }) {
+            BigInt first = row[0] * q + row[1];
+            row[1] = std::move(row[0]);
+            row[0] = std::move(first);
+        }
+        det = -det;
+        ++steps;
     }
-    BigInt halfpow = pow(base, exponent / 2);
-    if (exponent.digits[0] & 1) {
-        return base * halfpow * halfpow;
+
+    // *this = *this * [[d, b], [c, a]], the inverse of the step's [[A, B], [C, D]] and the product of its quotients.
+    // the entries must not be negative, as they are not while only quotients went in. each row is updated in place
+    // with the limb kernels: (x, y) becomes (x d + y c, x b + y a)
+    void push_step(const LehmerStep &step) {
+        digit_vector first, second;
+        for (BigInt *row : { m[0], m[1] }) {
+            const size_t n = std::max(row[0].num_digits(), row[1].num_digits());
+            row[0].digits.resize(n, 0);
+            row[1].digits.resize(n, 0);
+            for (auto [out, p, q] : { std::tuple(&first, step.d, step.c), std::tuple(&second, step.b, step.a) }) {
+                out->resize(n + 2);
+                const std::span<limb> low = std::span<limb>(*out).first(n);
+                const limb high0 = mpn::mul_1(low, row[0].digits, p); // must run before addmul_1 adds into low
+                const limb high1 = mpn::addmul_1(low, row[1].digits, q);
+                const dlimb top = (dlimb)high0 + high1;
+                (*out)[n] = (limb)top;
+                (*out)[n + 1] = (limb)(top >> BITS_IN_LIMB);
+            }
+            std::swap(row[0].digits, first);
+            std::swap(row[1].digits, second);
+            row[0].trim();
+            row[1].trim();
+        }
+        det = step.odd ? -det : det;
+        ++steps;
+    }
+
+    // *this = *this * right
+    void multiply(const GcdMatrix &right) {
+        if (right.steps == 0) {
+            return;
+        }
+        for (BigInt *row : { m[0], m[1] }) {
+            BigInt first = row[0] * right.m[0][0] + row[1] * right.m[1][0];
+            row[1] = row[0] * right.m[0][1] + row[1] * right.m[1][1];
+            row[0] = std::move(first);
+        }
+        det *= right.det;
+        steps += right.steps;
+    }
+
+    // makes a >= b >= 0 again after quotients found from the top limbs alone turned out wrong for the whole numbers,
+    // by negating or swapping them along with the matching columns, so the pair before stays m times the pair after
+    void normalize(BigInt &a, BigInt &b) {
+        for (size_t column = 0; column < 2; ++column) {
+            BigInt &x = column == 0 ? a : b;
+            if (!x.positive) {
+                x.positive = true;
+                for (BigInt *row : { m[0], m[1] }) {
+                    row[column].positive = !row[column].positive;
+                    row[column].trim();
+                }
+                det = -det;
+            }
+        }
+        if (a < b) {
+            std::swap(a, b);
+            std::swap(m[0][0], m[0][1]);
+            std::swap(m[1][0], m[1][1]);
+            det = -det;
+        }
+    }
+};
+
+// reduces a >= b >= 0 in place with Lehmer steps until b has at most s limbs (s = 0: until b is zero, leaving the gcd
+// in a). a step works on the top 2 * BITS_IN_LIMB - 1 bits of both, and its cofactors take the whole numbers a limb's
+// worth of bits down in one pass over their limbs. where the top bits cannot tell the next quotient (it is larger
+// than a limb) a division takes one step. with m, every step is multiplied into it
+void BigInt::lehmer_reduce(BigInt &a, BigInt &b, size_t s, GcdMatrix *m) {
+    BIGINT_STAT_SCOPE(GCD_LEHMER, a.num_digits());
+    GcdMatrix steps; // the steps of this call alone, whose entries stay non-negative for push_step
+    digit_vector next_a, next_b;
+    while (b != 0 && b.num_digits() > s) {
+        const size_t n = a.num_digits();
+        const size_t shift = a.bit_length() > 2 * BITS_IN_LIMB - 1 ? a.bit_length() - (2 * BITS_IN_LIMB - 1) : 0;
+        const LehmerStep step = lehmer_step(top_bits(a.digits, shift), top_bits(b.digits, shift));
+        if (step.b == 0) {
+            BigInt quotient, remainder;
+            long_div(a, b, quotient, remainder);
+            a = std::move(b);
+            b = std::move(remainder);
+            if (m) {
+                steps.push_quotient(quotient);
+            }
+            continue;
+        }
+        b.digits.resize(n, 0);
+        next_a.resize(n);
+        next_b.resize(n);
+        if (!step.odd) {
+            mul_1_sub_mul_1(next_a, a.digits, step.a, b.digits, step.b);
+            mul_1_sub_mul_1(next_b, b.digits, step.d, a.digits, step.c);
+        } else {
+            mul_1_sub_mul_1(next_a, b.digits, step.b, a.digits, step.a);
+            mul_1_sub_mul_1(next_b, a.digits, step.c, b.digits, step.d);
+        }
+        std::swap(a.digits, next_a);
+        std::swap(b.digits, next_b);
+        a.trim();
+        b.trim();
+        if (m) {
+            steps.push_step(step);
+        }
     }
-    else {
-        return halfpow * halfpow;
+    if (m) {
+        m->multiply(steps);
     }
 }
 
-// performs long multiplication (gradeschool multiplication) on two BigInts a and b, complexity O(n^2)
-BigInt BigInt::long_mult(const BigInt &a, const BigInt &b) {
-    const BigInt *longer = &a;
-    const BigInt *shorter = &b;
-    size_t longer_size = longer->num_digits();
-    size_t shorter_size = shorter->num_digits();
-    if (shorter_size > longer_size) { // want the BigInt with more digits on top for mult, gives less additions
-        std::swap(longer, shorter);
-        std::swap(longer_size, shorter_size);
+// reduces a >= b >= 0 in place until b has at most s limbs, like lehmer_reduce, recording the quotients in m. the
+// quotients that take n limbs down to s only depend on the top 2 (n - s) or so limbs, so for s around n / 2 they
+// come from numbers half as long: those that take the top n - s limbs halfway down (reduce_top at s), then from
+// what is left, n2 limbs, those that take its top 2 (n2 - s) limbs the rest of the way (reduce_top at 2 s - n2).
+// both halves recurse, Lehmer steps finish off the last limb or so, and the work is O(M(n) log n)
+void BigInt::hgcd(BigInt &a, BigInt &b, size_t s, GcdMatrix &m) {
+    const size_t n = a.num_digits();
+    if (b.num_digits() <= s) {
+        return;
     }
+    if (n < mpn::thresholds.hgcd) {
+        lehmer_reduce(a, b, s, &m);
+        return;
+    }
+    BIGINT_STAT_SCOPE(GCD_HGCD, n);
+    reduce_top(a, b, s, m);
+    const size_t n2 = a.num_digits();
+    if (b.num_digits() > s && 2 * s > n2 && 2 * (n2 - s) < n) {
+        GcdMatrix second;
+        reduce_top(a, b, 2 * s - n2, second);
+        m.multiply(second);
+    }
+    lehmer_reduce(a, b, s, &m);
+}
 
-    // perform multiplication algorithm
-    BigInt result;
-    size_t pad_zeros = 0;
-    for (size_t i = 0; i < shorter_size; ++i) {
-        uint overflow = 0;
-        std::vector<uint> add_digits(pad_zeros, 0); // pad successive BigInts to add with zeros
-        add_digits.reserve(longer_size + 1 + pad_zeros);
+// finds the quotients of a >= b from their limbs p and up with hgcd, which takes those halfway down, and applies them
+// to the whole numbers: with (a_hi, b_hi) = M (a_hi', b_hi'), the new pair is (a_hi' BASE^p, b_hi' BASE^p) + M^-1
+// (a_lo, b_lo), where M^-1 = det * [[m11, -m01], [-m10, m00]]. the last quotients can be wrong for the whole numbers,
+// which normalize() puts right
+void BigInt::reduce_top(BigInt &a, BigInt &b, size_t p, GcdMatrix &m) {
+    const size_t n = a.num_digits();
+    BigInt a_hi = a.limb_slice(p, n), b_hi = b.limb_slice(p, n);
+    hgcd(a_hi, b_hi, (n - p) / 2 + 1, m);
+    if (m.steps == 0) {
+        return;
+    }
+    const BigInt a_lo = a.limb_slice(0, p), b_lo = b.limb_slice(0, p);
+    const BigInt m11_a = m.m[1][1] * a_lo, m01_b = m.m[0][1] * b_lo, m10_a = m.m[1][0] * a_lo, m00_b = m.m[0][0] * b_lo;
+    const size_t bits = p * BITS_IN_LIMB;
+    if (m.det > 0) {
+        a = a_hi.scaled(bits) + m11_a - m01_b;
+        b = b_hi.scaled(bits) + m00_b - m10_a;
+    } else {
+        a = a_hi.scaled(bits) - m11_a + m01_b;
+        b = b_hi.scaled(bits) - m00_b + m10_a;
+    }
+    m.normalize(a, b);
+}
 
-        // multiply each digit of top BigNum by single digit of bottom BigNum
-        for (size_t j = 0; j < longer_size; ++j) {
-            ulonglong true_mult = ((ulonglong)shorter->digits[i] * longer->digits[j]) + overflow; // yes, 2^64-1 > (2^32-1)^2 + (2^32-1)
-            uint new_digit = (uint)true_mult;                                                     // gives result mod BASE
-            overflow = true_mult >> BITS_IN_UINT;                                                 // overflow = true_mult / BASE
-            add_digits.push_back(new_digit);
+// reduces a >= b >= 0 until b is zero, leaving the gcd in a: while b is long enough, hgcd of the top half of the
+// limbs takes both a quarter of the way down, and Lehmer steps do the rest. with m, every quotient is recorded
+void BigInt::gcd_reduce(BigInt &a, BigInt &b, GcdMatrix *m) {
+    while (b.num_digits() >= mpn::thresholds.hgcd) {
+        const size_t n = a.num_digits();
+        GcdMatrix step;
+        if (2 * b.num_digits() > n) {
+            reduce_top(a, b, n / 2, step);
         }
+        if (a.num_digits() == n && b != 0) { // b is much shorter than a, or hgcd got nowhere: a division gets things moving
+            BigInt quotient, remainder;
+            long_div(a, b, quotient, remainder);
+            a = std::move(b);
+            b = std::move(remainder);
+            step.push_quotient(quotient);
+        }
+        if (m) {
+            m->multiply(step);
+        }
+    }
+    lehmer_reduce(a, b, 0, m);
+}
 
-        // take care of possible remaining carry
-        if (overflow) {
-            add_digits.push_back(overflow);
+// returns gcd(|a|, |b|)
+BigInt BigInt::gcd(const BigInt &a, const BigInt &b) {
+    BIGINT_STAT_SCOPE(GCD, std::max(a.num_digits(), b.num_digits()));
+    BigInt u(a.digits, true), v(b.digits, true);
+    if (u < v) {
+        std::swap(u, v);
+    }
+    gcd_reduce(u, v, nullptr);
+    return u;
+}
+
+// sets g = gcd(a, b) and x, y with a x + b y = g. the reduction records its quotients in a matrix M with
+// (|a|, |b|) = M (g, 0), so (g, 0) = M^-1 (|a|, |b|) and the first row of M^-1, det * (m11, -m01), holds the
+// cofactors. those are then brought into the range documented in the header
+void BigInt::extended_gcd(const BigInt &a, const BigInt &b, BigInt &g, BigInt &x, BigInt &y) {
+    BIGINT_STAT_SCOPE(GCD, std::max(a.num_digits(), b.num_digits()));
+    BigInt u(a.digits, true), v(b.digits, true);
+    const bool swapped = u < v;
+    if (swapped) {
+        std::swap(u, v);
+    }
+    GcdMatrix m;
+    gcd_reduce(u, v, &m);
+    if (u == 0) {
+        g = x = y = BigInt();
+        return;
+    }
+    BigInt s = m.m[1][1], t = m.m[0][1]; // g = det * (s u - t v)
+    if (m.det < 0) {
+        s.positive = !s.positive;
+        t.positive = !t.positive;
+        s.trim();
+        t.trim();
+    }
+    t.positive = !t.positive;
+    t.trim();
+    if (swapped) {
+        std::swap(s, t);
+    }
+    // s and t now go with |a| and |b|, the signs of a and b go on them
+    s.positive = s.positive == a.positive;
+    t.positive = t.positive == b.positive;
+    s.trim();
+    t.trim();
+    g = std::move(u);
+    if (b != 0) {
+        // every solution is s + k |b| / g, take the one closest to zero
+        const BigInt step = BigInt(b.digits, true) / g;
+        s %= step;
+        if (!s.positive) {
+            s += step;
+        }
+        if (s.shifted_left(1) > step || (s.shifted_left(1) == step && !a.positive)) { // a tie only when step is 2
+            s = s - step;
         }
+        t = BigInt(g - a * s) / b;
+    }
+    x = std::move(s);
+    y = std::move(t);
+}
 
-        // keep running sum instead of storing
-        result += BigInt(add_digits, true);
-        ++pad_zeros;
+// returns the inverse of a mod m in [0, m)
+BigInt BigInt::mod_inverse(const BigInt &a, const BigInt &m) {
+    if (m <= 0) {
+        throw std::domain_error("BigInt::mod_inverse: modulus must be positive");
     }
-    return result;
+    BigInt g, x, y;
+    extended_gcd(a % m, m, g, x, y);
+    if (g != 1) {
+        throw std::domain_error("BigInt::mod_inverse: not invertible");
+    }
+    x %= m;
+    if (!x.positive) {
+        x += m;
+    }
+    return x;
 }
 
-// performs karatsuba multiplication (fast multiplication) on two BigInts a and b, complexity O(n^(log2(3)))
-BigInt BigInt::karatsuba_mult(const BigInt &x,
-                              const BigInt &y) {
-    const size_t x_n = x.num_digits();
-    const size_t y_n = y.num_digits();
+namespace {
+const size_t BATCH_LANES = 64;     // operands a lane kernel carries at once
+const size_t BATCH_LANE_LIMBS = 8; // operands up to this many limbs go through the lane kernels
+
+// runs body over [0, n), split into ranges over the executor's threads if there is one and the batch has at least
+// thresholds.parallel limbs of work
+void batch_for(size_t n, size_t work, const std::function<void(size_t, size_t)> &body) {
+    Executor *executor = mpn::get_executor();
+    if (!executor || n < 2 || work < mpn::thresholds.parallel) {
+        body(0, n);
+        return;
+    }
+    const size_t ranges = std::min(n, 4 * executor->concurrency()); // a few per thread to even out uneven operands
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < ranges; ++i) {
+        const size_t begin = n * i / ranges, end = n * (i + 1) / ranges;
+        tasks.push_back([&body, begin, end] { body(begin, end); });
+    }
+    executor->run(tasks);
+}
 
-    if (x_n < KARATSUBA_CUTOFF && y_n < KARATSUBA_CUTOFF) {
-        return long_mult(x, y); // karatsuba overhead not worth it, just do long multiplication
+void check_batch_sizes(size_t a, size_t b, size_t result) {
+    if (a != b || a != result) {
+        throw std::invalid_argument("BigInt: batch spans differ in size");
     }
+}
 
-    if (x_n == y_n) {
-        const size_t m = (x_n / 2) + (x_n % 2);                                          // x_n/2 if x_n is even, (x_n+1)/2 if x_n is odd
-        const BigInt a(std::vector<uint>(x.digits.begin() + m, x.digits.end()), true);   // initialize a to left half of x
-        const BigInt b(std::vector<uint>(x.digits.begin(), x.digits.begin() + m), true); // initialize b to right half of x
-        const BigInt c(std::vector<uint>(y.digits.begin() + m, y.digits.end()), true);   // initialize c to left half of y
-        const BigInt d(std::vector<uint>(y.digits.begin(), y.digits.begin() + m), true); // initialize d to right half of y
+// the lane kernels work on packed blocks of `lanes` operands of n limbs, limb i of lane j at [i * lanes + j]. the
+// inner loops run across lanes with a carry per lane, so they have no dependency from one iteration to the next
+
+// r = x + y per lane, r has n + 1 limbs
+void lanes_add(limb *r, const limb *x, const limb *y, size_t n, size_t lanes) {
+    std::array<limb, BATCH_LANES> carry{};
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < lanes; ++j) {
+            const limb sum = x[i * lanes + j] + y[i * lanes + j];
+            const limb total = sum + carry[j];
+            carry[j] = (limb)(sum < x[i * lanes + j]) | (limb)(total < sum);
+            r[i * lanes + j] = total;
+        }
+    }
+    std::copy_n(carry.begin(), lanes, r + n * lanes);
+}
 
-        BigInt ac = karatsuba_mult(a, c);
-        BigInt bd = karatsuba_mult(b, d);
-        BigInt ad_plus_bc = karatsuba_mult(a + b, c + d) - ac - bd; // (a+b)(c+d)=ac+ad+bc+bd ==> ac+ad+bc+bd-ac-bd=ad+bc
+// r = |x - y| per lane, with borrow[j] set where x < y. the lanes that borrowed hold x - y + BASE^n and are negated
+// in a second pass
+void lanes_sub(limb *r, const limb *x, const limb *y, size_t n, size_t lanes, limb *borrow) {
+    std::fill_n(borrow, lanes, 0);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < lanes; ++j) {
+            const limb difference = x[i * lanes + j] - y[i * lanes + j];
+            const limb total = difference - borrow[j];
+            borrow[j] = (limb)(x[i * lanes + j] < y[i * lanes + j]) | (limb)(difference < borrow[j]);
+            r[i * lanes + j] = total;
+        }
+    }
+    std::array<limb, BATCH_LANES> carry;
+    std::copy_n(borrow, lanes, carry.begin());
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < lanes; ++j) { // -d == ~d + 1, a no-op where the mask is zero
+            const limb negated = (r[i * lanes + j] ^ (0 - borrow[j])) + carry[j];
+            carry[j] = negated < carry[j];
+            r[i * lanes + j] = negated;
+        }
+    }
+}
 
-        if (ac > 0)
-            ac.digits.insert(ac.digits.begin(), 2 * m, 0); // multiply by BASE^(2*m)
-        if (ad_plus_bc > 0)
-            ad_plus_bc.digits.insert(ad_plus_bc.digits.begin(), m, 0); // multiply by BASE^m
+// r = x * y per lane by long multiplication, r has 2n limbs
+void lanes_mul(limb *r, const limb *x, const limb *y, size_t n, size_t lanes) {
+    std::fill_n(r, 2 * n * lanes, 0);
+    std::array<limb, BATCH_LANES> carry;
+    for (size_t i = 0; i < n; ++i) {
+        carry.fill(0);
+        for (size_t k = 0; k < n; ++k) {
+            for (size_t j = 0; j < lanes; ++j) {
+                const dlimb product = (dlimb)x[i * lanes + j] * y[k * lanes + j] + r[(i + k) * lanes + j] + carry[j];
+                r[(i + k) * lanes + j] = (limb)product;
+                carry[j] = (limb)(product >> BITS_IN_LIMB);
+            }
+        }
+        std::copy_n(carry.begin(), lanes, r + (i + n) * lanes);
+    }
+}
+} // namespace
+
+// packs the operands at the indices in lanes, all of them at most n limbs, runs the lane kernel for op over them and
+// unpacks the results. every operand is read before any result is written, so result may be a or b
+void BigInt::run_lanes(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result,
+                       std::span<const size_t> lanes, size_t n, LaneOp op) {
+    const size_t count = lanes.size();
+    const size_t r_limbs = op == LANE_PRODUCT ? 2 * n : n + 1;
+    ScratchArena::Frame frame;
+    const std::span<limb> x = frame.allocate<limb>(n * count), y = frame.allocate<limb>(n * count);
+    const std::span<limb> r = frame.allocate<limb>(r_limbs * count);
+    for (size_t j = 0; j < count; ++j) {
+        const digit_vector &a_digits = a[lanes[j]].digits, &b_digits = b[lanes[j]].digits;
+        for (size_t i = 0; i < n; ++i) {
+            x[i * count + j] = i < a_digits.size() ? a_digits[i] : 0;
+            y[i * count + j] = i < b_digits.size() ? b_digits[i] : 0;
+        }
+    }
 
-        return ac + ad_plus_bc + bd;
+    std::array<limb, BATCH_LANES> borrow{};
+    if (op == LANE_SUM) {
+        lanes_add(r.data(), x.data(), y.data(), n, count);
+    } else if (op == LANE_DIFFERENCE) {
+        std::fill(r.begin() + n * count, r.end(), 0); // a difference has no carry limb
+        lanes_sub(r.data(), x.data(), y.data(), n, count, borrow.data());
     } else {
-        const BigInt *biggest = &x;
-        const BigInt *smallest = &y;
-        if (biggest->num_digits() < smallest->digits.size()) { // x and y have a different number of digits, need to know which number has least digits to pad it
-            std::swap(biggest, smallest);
+        lanes_mul(r.data(), x.data(), y.data(), n, count);
+    }
+
+    // a sum keeps a's sign, a difference of magnitudes flips it where |b| > |a|, a product is positive for like signs
+    std::array<bool, BATCH_LANES> positive;
+    for (size_t j = 0; j < count; ++j) {
+        const BigInt &left = a[lanes[j]], &right = b[lanes[j]];
+        positive[j] = op == LANE_PRODUCT ? left.positive == right.positive : left.positive != (borrow[j] != 0);
+    }
+    for (size_t j = 0; j < count; ++j) { // straight into the result's own storage, which usually has room already
+        BigInt &out = result[lanes[j]];
+        out.digits.resize(r_limbs);
+        for (size_t i = 0; i < r_limbs; ++i) {
+            out.digits[i] = r[i * count + j];
         }
-        BigInt padded(*smallest);
-        padded.digits.insert(padded.digits.end(), biggest->num_digits() - smallest->num_digits(), 0); // pad the smaller number with leading 0s to equalize lengths
-        return karatsuba_mult(*biggest, padded);                                                      // restart karatsuba with our now same-length inputs
+        out.positive = positive[j];
+        out.trim();
+    }
+}
+
+// the operands are sorted into runs by length (and for sums by whether their magnitudes add or subtract) as they are
+// reached, a run is computed once BATCH_LANES operands have joined it, and long operands are done one at a time
+void BigInt::batch_arithmetic(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result,
+                              bool subtract, bool multiply) {
+    check_batch_sizes(a.size(), b.size(), result.size());
+    size_t work = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        work += a[i].num_digits() + b[i].num_digits();
     }
+    batch_for(a.size(), work, [&](size_t begin, size_t end) {
+        // runs[op][n] holds the waiting operands of n limbs for lane op
+        std::array<std::array<std::array<size_t, BATCH_LANES>, BATCH_LANE_LIMBS + 1>, 3> runs;
+        std::array<std::array<size_t, BATCH_LANE_LIMBS + 1>, 3> waiting{};
+        for (size_t i = begin; i < end; ++i) {
+            const size_t n = std::max(a[i].num_digits(), b[i].num_digits());
+            if (n > BATCH_LANE_LIMBS) {
+                if (multiply) {
+                    result[i] = a[i] * b[i];
+                } else {
+                    result[i] = add_signed(a[i], b[i], b[i].positive != subtract);
+                }
+                continue;
+            }
+            const LaneOp op = multiply ? LANE_PRODUCT : a[i].positive == (b[i].positive != subtract) ? LANE_SUM : LANE_DIFFERENCE;
+            runs[op][n][waiting[op][n]++] = i;
+            if (waiting[op][n] == BATCH_LANES) {
+                run_lanes(a, b, result, runs[op][n], n, op);
+                waiting[op][n] = 0;
+            }
+        }
+        for (int op = LANE_SUM; op <= LANE_PRODUCT; ++op) {
+            for (size_t n = 1; n <= BATCH_LANE_LIMBS; ++n) {
+                if (waiting[op][n] > 0) {
+                    run_lanes(a, b, result, std::span<const size_t>(runs[op][n]).first(waiting[op][n]), n, (LaneOp)op);
+                }
+            }
+        }
+    });
 }
 
-// todo
-BigInt BigInt::schonhage_strassen_mult(const BigInt &a, const BigInt &b) {
-    return BigInt();
+void BigInt::add_batch(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result) {
+    batch_arithmetic(a, b, result, false, false);
 }
 
-BigInt BigInt::long_div(const BigInt& a, const BigInt &b) {
+void BigInt::sub_batch(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result) {
+    batch_arithmetic(a, b, result, true, false);
+}
 
+void BigInt::mul_batch(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result) {
+    batch_arithmetic(a, b, result, false, true);
+}
+
+void BigInt::to_string_batch(std::span<const BigInt> values, std::span<std::string> result) {
+    check_batch_sizes(values.size(), values.size(), result.size());
+    size_t work = 0;
+    for (const BigInt &value : values) {
+        work += value.num_digits();
+    }
+    batch_for(values.size(), work, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            result[i] = values[i].to_string();
+        }
+    });
+}
+
+void BigInt::parse_batch(std::span<const std::string_view> strings, std::span<BigInt> result) {
+    check_batch_sizes(strings.size(), strings.size(), result.size());
+    size_t work = 0;
+    for (std::string_view str : strings) {
+        work += str.size() / POW10_DIGITS + 1;
+    }
+    batch_for(strings.size(), work, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            result[i] = BigInt(strings[i]);
+        }
+    });
+}
+
+// runs the sub-products of large multiplications on a pool of threads, threads <= 1 turns this off
+void BigInt::set_thread_count(size_t threads) {
+    mpn::set_executor(threads > 1 ? std::make_shared<ThreadPool>(threads) : nullptr);
+}
+
+// runs the sub-products of large multiplications on executor, nullptr turns this off
+void BigInt::set_executor(std::shared_ptr<Executor> executor) {
+    mpn::set_executor(std::move(executor));
+}
+
+// upstream resource for the blocks of every thread's scratch arena, nullptr for new/delete
+void BigInt::set_memory_resource(std::pmr::memory_resource *resource) {
+    ScratchArena::set_default_upstream(resource);
+}
+
+namespace {
+// the fields of Thresholds by name, with the smallest value their algorithms stay correct with: karatsuba and
+// burnikel-ziegler need halves of at least two digits, toom-4 needs four non-empty parts and the decimal
+// conversion's split must leave something above 10^18
+struct ThresholdField {
+    const char *name;
+    size_t Thresholds::*value;
+    size_t minimum;
+};
+
+const ThresholdField THRESHOLD_FIELDS[] = {
+    { "karatsuba", &Thresholds::karatsuba, 4 },
+    { "sqr_karatsuba", &Thresholds::sqr_karatsuba, 4 },
+    { "toom3", &Thresholds::toom3, 16 },
+    { "toom4", &Thresholds::toom4, 16 },
+    { "ntt", &Thresholds::ntt, 1 },
+    { "parallel", &Thresholds::parallel, 1 },
+    { "burnikel_ziegler", &Thresholds::burnikel_ziegler, 4 },
+    { "to_string", &Thresholds::to_string, 4 },
+    { "parse", &Thresholds::parse, 1 },
+    { "hgcd", &Thresholds::hgcd, 4 },
+};
+} // namespace
+
+Thresholds Thresholds::read(std::istream &in) {
+    Thresholds thresholds;
+    for (std::string line; std::getline(in, line);) {
+        line = line.substr(0, line.find('#'));
+        const size_t equals = line.find('=');
+        std::istringstream name_part(line.substr(0, equals));
+        std::string name, extra;
+        if (!(name_part >> name)) {
+            continue; // blank or comment line
+        }
+        std::istringstream value_part(equals == std::string::npos ? "" : line.substr(equals + 1));
+        size_t value;
+        if (equals == std::string::npos || name_part >> extra || !(value_part >> value) || value_part >> extra) {
+            throw std::invalid_argument("Thresholds: malformed line \"" + line + "\"");
+        }
+        const auto field = std::find_if(std::begin(THRESHOLD_FIELDS), std::end(THRESHOLD_FIELDS),
+                                        [&](const ThresholdField &f) { return name == f.name; });
+        if (field == std::end(THRESHOLD_FIELDS)) {
+            throw std::invalid_argument("Thresholds: unknown name \"" + name + "\"");
+        }
+        thresholds.*field->value = value;
+    }
+    return thresholds;
+}
+
+void Thresholds::write(std::ostream &out) const {
+    for (const ThresholdField &field : THRESHOLD_FIELDS) {
+        out << field.name << " = " << this->*field.value << '\n';
+    }
+}
+
+const Thresholds &BigInt::get_thresholds() {
+    return mpn::thresholds;
+}
+
+void BigInt::set_thresholds(const Thresholds &thresholds) {
+    for (const ThresholdField &field : THRESHOLD_FIELDS) {
+        if (thresholds.*field.value < field.minimum) {
+            throw std::invalid_argument(std::string("BigInt::set_thresholds: ") + field.name + " must be at least " +
+                                        std::to_string(field.minimum));
+        }
+    }
+    mpn::thresholds = thresholds;
 }
 
 // returns BigInt a where a = *this * right
 BigInt BigInt::operator*(const BigInt &right) const {
+    if (this == &right) {
+        return square();
+    }
     BigInt product;
-    product = karatsuba_mult(*this, right);
+    product = mult(*this, right);
     product.positive = !(this->positive ^ right.positive); // just think of truth table for mult of neg and pos
+    product.trim();
     return product;
 }
 
 // returns BigInt a where a = *this / right
 BigInt BigInt::operator/(const BigInt& right) const {
-    BigInt quotient;
-    quotient = long_div(*this, right);
-    quotient.positive = !(this->positive ^ right.positive);
+    BigInt quotient, remainder;
+    divmod(*this, right, quotient, remainder);
     return quotient;
 }
 
+// returns BigInt a where a = *this % right, a has the sign of *this
+BigInt BigInt::operator%(const BigInt& right) const {
+    BigInt quotient, remainder;
+    divmod(*this, right, quotient, remainder);
+    return remainder;
+}
+
 // copy-assignment operator
 BigInt &BigInt::operator=(const BigInt &right) {
-    digits = std::vector<uint>(right.digits);
+    digits = right.digits; // reuses our capacity when it is big enough
     positive = right.positive;
     return *this;
 }
@@ -455,47 +1822,16 @@ BigInt &BigInt::operator=(BigInt &&right) noexcept {
 
 // is *this == right?
 bool BigInt::operator==(const BigInt &right) const {
-    size_t my_size = this->num_digits();
-    if (my_size == right.num_digits()) {        // same # of digits, ok...
-        if (this->positive == right.positive) { // hmm, signs are the same too...
-            for (size_t i = 0; i < my_size; ++i) {
-                if (digits[i] != right.digits[i]) {
-                    return false; // nevermind, we have a different digit so we're different numbers
-                }
-            }
-            return true;
-        }
-    }
-    return false;
+    return this->positive == right.positive && compare_magnitudes(*this, right) == 0;
 }
 
 // is *this < right?
 bool BigInt::operator<(const BigInt &right) const {
-    size_t my_size = this->num_digits();
-    size_t their_size = right.num_digits();
     if (this->positive != right.positive) {
-        if (this->positive) {
-            return false;
-        }
-        return true;
-    }
-    if (my_size < their_size) {
-        return true;
+        return !this->positive;
     }
-    if (my_size > their_size) {
-        return false;
-    }
-
-    size_t i = my_size - 1;
-    size_t j = their_size - 1;
-    while (i > 0 && j > 0) { // go from MSB -> LSB, first num with smaller digit is smaller
-        if (digits[i] < right.digits[j]) {
-            return true;
-        }
-        --i;
-        --j;
-    }
-    return digits[i] < right.digits[j];
+    int cmp = compare_magnitudes(*this, right);
+    return this->positive ? cmp < 0 : cmp > 0; // larger magnitude means smaller value for negatives
 }
 
 // is *this > right?
@@ -522,45 +1858,66 @@ bool BigInt::operator>=(const BigInt &right) const {
     return false;
 }
 
-// returns BigInt a where a = *this + right
-BigInt BigInt::operator+(const BigInt& right) const {
-    // same sign
-    if (this->positive == right.positive) {
-        return add_like_signs(*this, right);
-    }
+// returns BigInt a where a = *this + right, in one pass into a new buffer
+BigInt BigInt::operator+(const BigInt &right) const& {
+    return BigInt(scaled(0) + right);
+}
 
-    // diff signs
-    BigInt me(*this);   // BAD
-    BigInt them(right); // BAD 
-    bool my_sign = me.positive;
-    bool their_sign = them.positive;
-    me.positive = true;
-    them.positive = true;
-    if (me < right) { 
-        me.positive = my_sign;
-        them.positive = their_sign;
-        return add_diff_signs(them, me); // want to send higher mag BigNum as first arg
-    }
-    them.positive = their_sign;
-    me.positive = my_sign;
-    return add_diff_signs(me, them);
+// the temporary operand's digit storage takes the result
+BigInt BigInt::operator+(const BigInt &right) && {
+    add_in_place(right, right.positive);
+    return std::move(*this);
+}
+
+BigInt BigInt::operator+(BigInt &&right) const& {
+    right.add_in_place(*this, positive);
+    return std::move(right);
+}
+
+BigInt BigInt::operator+(BigInt &&right) && {
+    add_in_place(right, right.positive);
+    return std::move(*this);
+}
+
+// returns BigInt a where a = *this - right, in one pass into a new buffer
+BigInt BigInt::operator-(const BigInt &right) const& {
+    return BigInt(scaled(0) - right);
+}
+
+BigInt BigInt::operator-(const BigInt &right) && {
+    add_in_place(right, !right.positive);
+    return std::move(*this);
 }
 
-// returns BigInt a where a = *this - right
-BigInt BigInt::operator-(const BigInt &right) const {
-    BigInt opp_right = BigInt(right.digits, !right.positive); // BAD!!!
-    return *this + opp_right;
+// right = -right + *this
+BigInt BigInt::operator-(BigInt &&right) const& {
+    right.positive = !right.positive;
+    right.add_in_place(*this, positive);
+    return std::move(right);
+}
+
+BigInt BigInt::operator-(BigInt &&right) && {
+    add_in_place(right, !right.positive);
+    return std::move(*this);
+}
+
+// returns -*this
+BigInt BigInt::operator-() const {
+    BigInt result(*this);
+    result.positive = !positive;
+    result.trim();
+    return result;
 }
 
 // return reference to *this after adding right to it
 BigInt &BigInt::operator+=(const BigInt &right) {
-    *this = *this + right;
+    add_in_place(right, right.positive);
     return *this;
 }
 
 // return reference to *this after subtracting right from it
 BigInt &BigInt::operator-=(const BigInt &right) {
-    *this = *this - right;
+    add_in_place(right, !right.positive);
     return *this;
 }
 
@@ -569,3 +1926,160 @@ BigInt &BigInt::operator*=(const BigInt &right) {
     *this = *this * right;
     return *this;
 }
+
+// return reference to *this after dividing by right
+BigInt &BigInt::operator/=(const BigInt &right) {
+    *this = *this / right;
+    return *this;
+}
+
+// return reference to *this after taking its remainder mod right
+BigInt &BigInt::operator%=(const BigInt &right) {
+    *this = *this % right;
+    return *this;
+}
+
+// returns *this * 2^bits
+BigInt BigInt::operator<<(size_t bits) const {
+    BigInt result = shifted_left(bits);
+    result.positive = positive;
+    return result;
+}
+
+// returns floor(*this / 2^bits)
+BigInt BigInt::operator>>(size_t bits) const {
+    if (positive) {
+        return shifted_right(bits);
+    }
+    BigInt result(*this);
+    result >>= bits;
+    return result;
+}
+
+// shifts the limbs up in place, top down so no limb is overwritten before it is read
+BigInt &BigInt::operator<<=(size_t bits) {
+    if (bit_length() == 0) {
+        return *this;
+    }
+    const size_t limbs = bits / BITS_IN_LIMB;
+    const size_t n = num_digits();
+    digits.resize(n + limbs + 1);
+    const std::span<limb> d(digits.data(), n + limbs + 1);
+    if (bits % BITS_IN_LIMB) {
+        d[n + limbs] = mpn::lshift(d.subspan(limbs, n), d.first(n), bits % BITS_IN_LIMB);
+    } else {
+        std::copy_backward(d.begin(), d.begin() + n, d.begin() + limbs + n);
+        d[n + limbs] = 0;
+    }
+    std::fill(d.begin(), d.begin() + limbs, 0);
+    trim();
+    return *this;
+}
+
+// shifts the limbs down in place, bottom up. a negative number that loses set bits rounds down, i.e. its magnitude
+// goes up by one
+BigInt &BigInt::operator>>=(size_t bits) {
+    const bool round_down = !positive && any_low_bits(digits, bits);
+    const size_t limbs = bits / BITS_IN_LIMB;
+    if (limbs >= num_digits()) {
+        return *this = round_down ? BigInt(-1) : BigInt();
+    }
+    const size_t n = num_digits() - limbs;
+    if (bits > 0) {
+        const std::span<limb> d(digits.data(), digits.size());
+        mpn::rshift(d.first(n), d.subspan(limbs), bits % BITS_IN_LIMB);
+        digits.resize(n);
+    }
+    if (round_down) {
+        const std::span<limb> d(digits.data(), n);
+        if (mpn::add_1(d, d, 1)) {
+            digits.push_back(1);
+        }
+    }
+    trim();
+    return *this;
+}
+
+// *this = *this op right for a limb-wise op. both operands are turned into two's complement one limb at a time as
+// the loop reaches them, ~(|x| - 1) for negative x, and so is a negative result, so nothing is copied. the sign
+// is op applied to the operands' sign limbs. complexity O(n)
+template <typename Op>
+void BigInt::bitwise_assign(const BigInt &right, Op op) {
+    const size_t right_size = right.num_digits();
+    const size_t n = std::max(num_digits(), right_size);
+    digits.resize(n, 0);
+    const limb *right_digits = right.digits.data(); // after the resize, right may be *this
+    const bool left_negative = !positive, right_negative = !right.positive;
+    const bool negative = op(left_negative ? _LIMB_MAX : 0, right_negative ? _LIMB_MAX : 0) != 0;
+    limb left_borrow = left_negative, right_borrow = right_negative, carry = negative;
+    for (size_t i = 0; i < n; ++i) {
+        limb x = digits[i], y = i < right_size ? right_digits[i] : 0;
+        if (left_negative) {
+            const limb d = x - left_borrow;
+            left_borrow = x < left_borrow;
+            x = ~d;
+        }
+        if (right_negative) {
+            const limb d = y - right_borrow;
+            right_borrow = y < right_borrow;
+            y = ~d;
+        }
+        limb r = op(x, y);
+        if (negative) {
+            r = ~r + carry;
+            carry = r < carry;
+        }
+        digits[i] = r;
+    }
+    if (negative && carry) { // the result is -BASE^n
+        digits.push_back(1);
+    }
+    positive = !negative;
+    trim();
+}
+
+BigInt BigInt::operator&(const BigInt &right) const {
+    BigInt result(*this);
+    return result &= right;
+}
+
+BigInt BigInt::operator|(const BigInt &right) const {
+    BigInt result(*this);
+    return result |= right;
+}
+
+BigInt BigInt::operator^(const BigInt &right) const {
+    BigInt result(*this);
+    return result ^= right;
+}
+
+// returns -*this - 1
+BigInt BigInt::operator~() const {
+    BigInt result(*this);
+    const std::span<limb> d(result.digits.data(), result.digits.size());
+    if (positive) {
+        if (mpn::add_1(d, d, 1)) {
+            result.digits.push_back(1);
+        }
+    } else {
+        mpn::sub_1(d, d, 1);
+    }
+    result.positive = !positive;
+    result.trim();
+    return result;
+}
+
+BigInt &BigInt::operator&=(const BigInt &right) {
+    bitwise_assign(right, [](limb x, limb y) { return x & y; });
+    return *this;
+}
+
+BigInt &BigInt::operator|=(const BigInt &right) {
+    bitwise_assign(right, [](limb x, limb y) { return x | y; });
+    return *this;
+}
+
+BigInt &BigInt::operator^=(const BigInt &right) {
+    bitwise_assign(right, [](limb x, limb y) { return x ^ y; });
+    return *this;
+}
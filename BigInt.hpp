@@ -1,11 +1,22 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cmath>
 #include <limits>
 #include <algorithm>
 #include <sstream>
+#include <utility>
+#include <stdexcept>
+#include <bit>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <array>
+#include <memory_resource>
+#include "SmallVector.hpp"
+#include "ThreadPool.hpp"
 
 //#include "Timer.hpp"
 
@@ -22,27 +33,125 @@ const size_t BITS_IN_NIBBLE = 4;
 const size_t BITS_IN_BYTE = 8;
 const size_t BITS_IN_UINT = UINT_BYTES * BITS_IN_BYTE;
 const size_t UCHARS_IN_UINT = UINT_BYTES / UCHAR_BYTES;
-const uint KARATSUBA_CUTOFF = 50;
+
+// define BIGINT_64BIT_LIMBS to store base 2^64 digits, which halves the number of limbs every kernel loops over.
+// it needs a compiler with unsigned __int128 for the double-width limb, without one we stay on base 2^32 digits
+#if defined(BIGINT_64BIT_LIMBS) && defined(__SIZEOF_INT128__)
+#define BIGINT_LIMB64 1
+typedef ulonglong limb;          // one base 2^64 digit
+typedef unsigned __int128 dlimb; // wide enough for the product of two limbs plus two carries
+typedef __int128 sdlimb;          // signed, for sums of a few limbs with a signed carry
+#else
+#define BIGINT_LIMB64 0
+typedef uint limb;       // one base 2^32 digit
+typedef ulonglong dlimb; // wide enough for the product of two limbs plus two carries
+typedef long long sdlimb; // signed, for sums of a few limbs with a signed carry
+#endif
+const size_t BITS_IN_LIMB = sizeof(limb) * BITS_IN_BYTE;
+const size_t UINTS_IN_LIMB = sizeof(limb) / UINT_BYTES;
+
+const size_t INLINE_LIMBS = 4; // digits stored inside the BigInt itself before spilling to the heap
+const uint DISPATCH_CUTOFF = 16; // array length (in digits) below which limb kernels skip the call to the CPU-specific version
+// default crossover points between algorithms, the ones in use can be changed at runtime (see Thresholds below)
+const uint KARATSUBA_CUTOFF = 32; // operand size (in digits) below which multiplication stays with long multiplication
+const uint SQR_KARATSUBA_CUTOFF = 64; // operand size (in digits) below which squaring stays with the symmetric long multiplication
+const uint TOOM3_CUTOFF = 300; // operand size (in digits) above which toom-3 beats karatsuba
+const uint TOOM4_CUTOFF = 800; // operand size (in digits) above which toom-4 beats toom-3
+const uint NTT_CUTOFF = 15000; // shorter operand size (in digits) above which the number theoretic transform beats toom-4
+const uint PARALLEL_CUTOFF = 2000; // size (in digits) above which a multiplication's sub-products run on the executor, if one is set
+const size_t NTT_MAX_LENGTH = ((size_t)1 << 24) / UINTS_IN_LIMB; // longest product (in digits) the three NTT primes can represent exactly
+const uint TO_STRING_CUTOFF = 30; // size (in digits) below which decimal conversion stops splitting and converts directly
+const uint PARSE_CUTOFF = 32; // size (in base 10^9 chunks) below which parsing stops splitting and multiplies-and-adds directly
+const uint BURNIKEL_ZIEGLER_CUTOFF = 40; // divisor size (in digits) below which schoolbook division wins
+const uint HGCD_CUTOFF = 250; // operand size (in digits) below which gcd takes Lehmer steps instead of half-gcd ones
 
 const uint BIGGEST_POW10 = (uint)1000000000; // max power of 10 we can store in 32 bits
 const uint POW10_DIGITS = log10(BIGGEST_POW10);
 
+// crossover points between algorithms, read at runtime by every operation. they start at the constants above, a
+// set tuned for the host can be measured with tune.cpp and installed with BigInt::set_thresholds. each has a
+// minimum the algorithms need to stay correct, see set_thresholds
+struct Thresholds {
+	size_t karatsuba = KARATSUBA_CUTOFF;
+	size_t sqr_karatsuba = SQR_KARATSUBA_CUTOFF;
+	size_t toom3 = TOOM3_CUTOFF;
+	size_t toom4 = TOOM4_CUTOFF;
+	size_t ntt = NTT_CUTOFF;
+	size_t parallel = PARALLEL_CUTOFF;
+	size_t burnikel_ziegler = BURNIKEL_ZIEGLER_CUTOFF;
+	size_t to_string = TO_STRING_CUTOFF;
+	size_t parse = PARSE_CUTOFF; // in base 10^9 chunks like PARSE_CUTOFF, the others are in digits
+	size_t hgcd = HGCD_CUTOFF;
+
+	// reads "name = value" lines as written by write, '#' starts a comment. names that are left out keep their
+	// defaults, an unknown name or a malformed line throws std::invalid_argument
+	static Thresholds read(std::istream& in);
+	void write(std::ostream& out) const;
+};
+
+// one term of a LinearSum: the value (negative ? -1 : 1) * magnitude * 2^shift
+struct SumTerm {
+	std::span<const limb> magnitude;
+	bool negative;
+	size_t shift; // in bits
+};
+
+template <size_t N> class LinearSum;
+
+// a number in the binary format of BigInt::to_binary, looked at where it lies (e.g. in a memory-mapped file) instead
+// of copied out, see BigInt::view_binary. magnitude points into the buffer, which must outlive the view
+struct BinaryView {
+	std::span<const limb> magnitude; // least significant limb first, no zero limb on top
+	bool negative;
+	size_t size; // bytes the number takes in the buffer, the next one starts there
+
+	// as a LinearSum term: BigInt(view.scaled()) copies the number out, x + view.scaled() adds it in place
+	LinearSum<1> scaled(size_t bits = 0) const;
+};
+
 class BigInt { 
 private:
-	std::vector<uint> digits;
+	friend class ModularContext;
+	friend class ProductTree;
+
+	typedef SmallVector<limb, INLINE_LIMBS> digit_vector;
+	digit_vector digits;
 	bool positive;
-	static const uint _UINT_MAX = std::numeric_limits<uint>::max();
-	static const ulonglong BASE = _UINT_MAX + (ulonglong)1;
+	static const limb _LIMB_MAX = std::numeric_limits<limb>::max();
+	static constexpr dlimb BASE = (dlimb)_LIMB_MAX + 1;
 
-	BigInt(const std::vector<uint>& digits_in, const bool positive_in);
+	BigInt(digit_vector digits_in, const bool positive_in);
 
 	template<typename T> void init(T _num);
-	static BigInt add_like_signs(const BigInt& a, const BigInt& b);
-	static BigInt add_diff_signs(const BigInt& a, const BigInt& b);
-	static BigInt long_mult(const BigInt& a, const BigInt& b);
-	static BigInt karatsuba_mult(const BigInt& a, const BigInt& b); // todo
-	static BigInt schonhage_strassen_mult(const BigInt& a, const BigInt& b); // todo
-	static BigInt long_div(const BigInt& a, const BigInt& b);
+	void trim();
+	BigInt limb_slice(size_t lo, size_t hi) const;
+	BigInt shifted_left(size_t bits) const;
+	BigInt shifted_right(size_t bits) const;
+	static int compare_magnitudes(const BigInt& a, const BigInt& b);
+	static const BigInt& pow10_power(size_t k);
+	void append_decimal(std::string& out, size_t width) const;
+	static void append_decimal_recursive(const BigInt& x, size_t k, size_t width, std::string& out);
+	static BigInt parse_decimal(std::string_view str);
+	static BigInt add_like_signs(const BigInt& a, const BigInt& b, bool positive);
+	static BigInt add_diff_signs(const BigInt& big, const BigInt& small, bool positive);
+	static BigInt add_signed(const BigInt& a, const BigInt& b, bool b_positive);
+	void add_in_place(const BigInt& b, bool b_positive);
+	void assign_sum(std::span<const SumTerm> terms);
+	static BigInt mult(const BigInt& a, const BigInt& b);
+	static BigInt pow_digits(const BigInt& base, const digit_vector& exponent);
+	static size_t product_split(std::span<const BigInt> factors);
+	static BigInt product_of_small(std::span<const ulonglong> factors);
+	static BigInt odd_factorial(ulonglong n, std::span<const ulonglong> primes);
+	struct GcdMatrix; // a record of the quotients of a gcd reduction, see BigInt.cpp
+	static void lehmer_reduce(BigInt& a, BigInt& b, size_t s, GcdMatrix* m);
+	static void hgcd(BigInt& a, BigInt& b, size_t s, GcdMatrix& m);
+	static void reduce_top(BigInt& a, BigInt& b, size_t p, GcdMatrix& m);
+	static void gcd_reduce(BigInt& a, BigInt& b, GcdMatrix* m);
+	static void long_div(const BigInt& a, const BigInt& b, BigInt& quotient, BigInt& remainder);
+	template <typename Op> void bitwise_assign(const BigInt& right, Op op);
+	enum LaneOp { LANE_SUM, LANE_DIFFERENCE, LANE_PRODUCT }; // what a batch does to the magnitudes of a run of lanes
+	static void batch_arithmetic(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result, bool subtract, bool multiply);
+	static void run_lanes(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result, std::span<const size_t> lanes, size_t n, LaneOp op);
 
 public:
 	BigInt();
@@ -53,24 +162,108 @@ public:
 	BigInt(long long num);
 	BigInt(float num);
 	BigInt(double num);
+	explicit BigInt(std::string_view str);
+	BigInt(std::string_view str, unsigned base); // base 2, 8, 10 or 16, hex digits in either case
+	explicit BigInt(std::istream& in);
+	template <size_t N> BigInt(const LinearSum<N>& sum);
 
-	std::vector<uint> get_digits() const;
-	static std::vector<bool> get_bits(uint num, bool pad_32 = false);
+	std::vector<limb> get_digits() const;
+	static std::vector<bool> get_bits(limb num, bool pad_limb = false);
 	std::vector<bool> get_bits() const;
 	std::string to_string() const;
 	std::string to_string2() const;
 	std::string to_binary_string() const;
+	// base 2, 8, 10 or 16 with lowercase digits and a '-' for negative numbers. the power of two bases take O(n),
+	// a table lookup per 8 or 12 bits
+	std::string to_string(unsigned base) const;
 	size_t num_digits() const;
+	size_t bit_length() const; // bits in the magnitude, 0 for zero
+	size_t popcount() const;   // set bits in the magnitude
+
+	// binary format, the same on every host and limb size: a 16 byte header ("BIGI", the format version, a flags
+	// byte with bit 0 set for negative numbers, two zero bytes, and the magnitude's length in 64-bit words as a
+	// little-endian 64-bit integer) followed by the magnitude in little-endian 64-bit words, least significant
+	// first, with no zero word on top (zero has no words). on little-endian hosts those words are the limbs' own
+	// bytes, so writing and reading a number is a copy of its limbs and view_binary copies nothing
+	std::span<const limb> limbs() const; // the magnitude in place, least significant first, valid until *this changes
+	size_t binary_size() const;
+	std::vector<std::byte> to_binary() const;
+	void write_binary(std::ostream& out) const;
+	// both read the number at the start of data, anything after it is left alone, and throw std::invalid_argument if
+	// it is malformed or cut short. view_binary also throws on big-endian hosts and when data's limbs are not aligned
+	// for limb (a buffer aligned to 8 bytes always works), from_binary has neither restriction
+	static BigInt from_binary(std::span<const std::byte> data);
+	static BinaryView view_binary(std::span<const std::byte> data);
+	// reads a number written by write_binary. sets failbit on the stream (returning zero) if it is malformed or cut short
+	static BigInt read_binary(std::istream& in);
+
+	// *this * 2^bits as a LinearSum term, so shifted values join a sum without being materialized. a temporary's
+	// term would outlive it, so on one the shift is done right away and gives a BigInt
+	LinearSum<1> scaled(size_t bits) const&;
+	BigInt scaled(size_t bits) &&;
 	
+	BigInt square() const;
 	static BigInt pow(const BigInt& a, const BigInt& b);
+	static BigInt pow(const BigInt& a, ulonglong b);
+	static void divmod(const BigInt& a, const BigInt& b, BigInt& quotient, BigInt& remainder);
+
+	// products of many factors, multiplied as a balanced tree so both sides of each multiplication are about the
+	// same length and the fast multiplication tiers get to work (one factor at a time into an accumulator is
+	// quadratic). product of no factors is 1. factorial uses the prime swing, binomial the primes of n! / (k! (n-k)!)
+	// or, for k much smaller than n, the falling factorial divided by k!. both sieve the primes up to n
+	static BigInt product(std::span<const BigInt> factors);
+	static BigInt factorial(ulonglong n);
+	static BigInt binomial(ulonglong n, ulonglong k); // 0 if k > n
+	static BigInt primorial(ulonglong n);             // the product of the primes <= n
+
+	// greatest common divisor, never negative (gcd(0, 0) is 0). Lehmer's algorithm, which takes the quotients of
+	// about a limb's worth of euclid steps from the top two limbs and applies them in one pass, and above
+	// thresholds.hgcd the half-gcd, which finds the quotients that take the top half of the numbers halfway down
+	// recursively and applies them with the fast multiplication, O(M(n) log n). extended_gcd also sets x and y with
+	// a x + b y = g, |x| <= |b| / (2 g) and |y| <= |a| / (2 g) where those are at least 1 (x = sign(a) if b is 0)
+	static BigInt gcd(const BigInt& a, const BigInt& b);
+	static void extended_gcd(const BigInt& a, const BigInt& b, BigInt& g, BigInt& x, BigInt& y);
+	// x in [0, m) with a x = 1 mod m. throws std::domain_error if m is not positive or gcd(a, m) is not 1
+	static BigInt mod_inverse(const BigInt& a, const BigInt& m);
+
+	// batch operations: result[i] = a[i] op b[i] over whole arrays (result may be a or b itself), and conversions
+	// of whole arrays. small operands are sorted into runs of one length and packed into the scratch arena as
+	// structure-of-arrays blocks (limb i of every lane side by side), so one loop carries every lane of a run and the
+	// compiler vectorizes it. with an executor set (see set_thread_count) the arrays are split over its threads.
+	// spans of different sizes throw std::invalid_argument, parse_batch throws like the string constructor
+	static void add_batch(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result);
+	static void sub_batch(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result);
+	static void mul_batch(std::span<const BigInt> a, std::span<const BigInt> b, std::span<BigInt> result);
+	static void to_string_batch(std::span<const BigInt> values, std::span<std::string> result);
+	static void parse_batch(std::span<const std::string_view> strings, std::span<BigInt> result);
+
+	// parallel multiplication: large products split their independent sub-products over threads.
+	// set_thread_count(n) runs them on an n-thread ThreadPool (1 turns it off again, the default), set_executor
+	// hands them to any Executor (nullptr turns it off). neither may be called while a multiplication is running
+	static void set_thread_count(size_t threads);
+	static void set_executor(std::shared_ptr<Executor> executor);
+
+	// multiplication and division temporaries come from a per-thread ScratchArena (see ScratchArena.hpp) that keeps
+	// its blocks between operations. set_memory_resource makes arenas take new blocks from resource (nullptr goes back
+	// to new/delete). resource must outlive those blocks, which an arena keeps until its release() or the end of its
+	// thread. a ScratchArena::Scope lends a thread an arena of the caller's own instead
+	static void set_memory_resource(std::pmr::memory_resource* resource);
+
+	// the crossover points in use. set_thresholds throws std::invalid_argument, and changes nothing, if a value is
+	// below its minimum (4 for karatsuba, sqr_karatsuba, burnikel_ziegler and to_string, 16 for toom3 and toom4, 1
+	// for the rest). it must not be called while arithmetic is running
+	static const Thresholds& get_thresholds();
+	static void set_thresholds(const Thresholds& thresholds);
 
 	// assignment operator overloads
 	BigInt& operator= (const BigInt& right);
 	BigInt& operator= (BigInt&& right) noexcept;
+	template <size_t N> BigInt& operator= (const LinearSum<N>& right);
 	BigInt& operator+= (const BigInt& right);
-	BigInt& operator-= (const BigInt& right); // todo
-	BigInt& operator*= (const BigInt& right); // todo
-	BigInt& operator/= (const BigInt& right); // todo
+	BigInt& operator-= (const BigInt& right);
+	BigInt& operator*= (const BigInt& right);
+	BigInt& operator/= (const BigInt& right);
+	BigInt& operator%= (const BigInt& right);
 
 	// comparison operator overloads
 	bool operator== (const BigInt& right) const;
@@ -79,9 +272,133 @@ public:
 	bool operator<= (const BigInt& right) const;
 	bool operator>= (const BigInt& right) const;
 
-	// arithmetic operator overloads
-	BigInt operator+ (const BigInt& right) const;
-	BigInt operator- (const BigInt& right) const;
+	// arithmetic operator overloads. + and - on a temporary work in its own digit storage, so a + b - c takes one
+	// buffer. adding a LinearSum (see below) stays lazy unless this is a temporary
+	BigInt operator+ (const BigInt& right) const&;
+	BigInt operator+ (const BigInt& right) &&;
+	BigInt operator+ (BigInt&& right) const&;
+	BigInt operator+ (BigInt&& right) &&;
+	BigInt operator- (const BigInt& right) const&;
+	BigInt operator- (const BigInt& right) &&;
+	BigInt operator- (BigInt&& right) const&;
+	BigInt operator- (BigInt&& right) &&;
+	template <size_t N> LinearSum<N + 1> operator+ (const LinearSum<N>& right) const&;
+	template <size_t N> LinearSum<N + 1> operator- (const LinearSum<N>& right) const&;
+	template <size_t N> BigInt operator+ (const LinearSum<N>& right) &&;
+	template <size_t N> BigInt operator- (const LinearSum<N>& right) &&;
+	BigInt operator- () const;
 	BigInt operator* (const BigInt& right) const;
-	BigInt operator/ (const BigInt& right) const; // todo
+	BigInt operator/ (const BigInt& right) const;
+	BigInt operator% (const BigInt& right) const;
+
+	// shifts and bitwise operators work on the two's complement of the numbers, extended with infinitely many sign
+	// bits, like python's ints: x >> k rounds toward negative infinity, ~x == -x - 1 and -1 & x == x
+	BigInt operator<< (size_t bits) const;
+	BigInt operator>> (size_t bits) const;
+	BigInt& operator<<= (size_t bits);
+	BigInt& operator>>= (size_t bits);
+	BigInt operator& (const BigInt& right) const;
+	BigInt operator| (const BigInt& right) const;
+	BigInt operator^ (const BigInt& right) const;
+	BigInt operator~ () const;
+	BigInt& operator&= (const BigInt& right);
+	BigInt& operator|= (const BigInt& right);
+	BigInt& operator^= (const BigInt& right);
+};
+
+// a chain of + and - that starts with a scaled term, e.g. x.scaled(64) + y - z, is collected into a LinearSum
+// instead of making a temporary BigInt per operator. it is evaluated when converted to or assigned to a BigInt, one
+// kernel pass per term into one buffer (the target's own when assigning). a LinearSum refers to its operands, which
+// is why only named BigInts become terms: a temporary joining a chain evaluates it right away into the temporary's
+// storage. a sum kept in a variable stays valid as long as the BigInts it was built from
+template <size_t N>
+class LinearSum {
+public:
+	std::array<SumTerm, N> terms;
+
+	LinearSum<N + 1> operator+ (const BigInt& right) const { return append(right.scaled(0).terms, false); }
+	LinearSum<N + 1> operator- (const BigInt& right) const { return append(right.scaled(0).terms, true); }
+	BigInt operator+ (BigInt&& right) const { return evaluate_into(right, false); }
+	BigInt operator- (BigInt&& right) const { return evaluate_into(right, true); }
+	template <size_t M> LinearSum<N + M> operator+ (const LinearSum<M>& right) const { return append(right.terms, false); }
+	template <size_t M> LinearSum<N + M> operator- (const LinearSum<M>& right) const { return append(right.terms, true); }
+
+	BigInt eval() const { return BigInt(*this); }
+	std::string to_string(unsigned base = 10) const { return eval().to_string(base); }
+	BigInt operator- () const { return -eval(); }
+	BigInt operator~ () const { return ~eval(); }
+
+private:
+	template <size_t M>
+	LinearSum<N + M> append(const std::array<SumTerm, M>& more, bool negate) const {
+		LinearSum<N + M> sum;
+		std::copy(terms.begin(), terms.end(), sum.terms.begin());
+		for (size_t i = 0; i < M; ++i) {
+			sum.terms[N + i] = more[i];
+			sum.terms[N + i].negative ^= negate;
+		}
+		return sum;
+	}
+
+	BigInt evaluate_into(BigInt& right, bool negate) const {
+		right = append(right.scaled(0).terms, negate);
+		return std::move(right);
+	}
 };
+
+inline LinearSum<1> BinaryView::scaled(size_t bits) const {
+	return LinearSum<1>{{SumTerm{magnitude, negative, bits}}};
+}
+
+template <size_t N>
+BigInt::BigInt(const LinearSum<N>& sum) : BigInt() {
+	assign_sum(sum.terms);
+}
+
+template <size_t N>
+BigInt& BigInt::operator= (const LinearSum<N>& right) {
+	assign_sum(right.terms);
+	return *this;
+}
+
+template <size_t N>
+LinearSum<N + 1> BigInt::operator+ (const LinearSum<N>& right) const& {
+	return scaled(0) + right;
+}
+
+template <size_t N>
+LinearSum<N + 1> BigInt::operator- (const LinearSum<N>& right) const& {
+	return scaled(0) - right;
+}
+
+template <size_t N>
+BigInt BigInt::operator+ (const LinearSum<N>& right) && {
+	*this = scaled(0) + right;
+	return std::move(*this);
+}
+
+template <size_t N>
+BigInt BigInt::operator- (const LinearSum<N>& right) && {
+	*this = scaled(0) - right;
+	return std::move(*this);
+}
+
+inline std::ostream& operator<< (std::ostream& out, const BigInt& value) {
+	return out << value.to_string();
+}
+
+// the other operators take BigInts, evaluate a LinearSum on their left first
+template <size_t N> BigInt operator* (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) * right; }
+template <size_t N> BigInt operator/ (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) / right; }
+template <size_t N> BigInt operator% (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) % right; }
+template <size_t N> bool operator< (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) < right; }
+template <size_t N> bool operator> (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) > right; }
+template <size_t N> bool operator<= (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) <= right; }
+template <size_t N> bool operator>= (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) >= right; }
+template <size_t N> bool operator== (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) == right; }
+template <size_t N> BigInt operator<< (const LinearSum<N>& left, size_t bits) { return BigInt(left) << bits; }
+template <size_t N> BigInt operator>> (const LinearSum<N>& left, size_t bits) { return BigInt(left) >> bits; }
+template <size_t N> BigInt operator& (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) & right; }
+template <size_t N> BigInt operator| (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) | right; }
+template <size_t N> BigInt operator^ (const LinearSum<N>& left, const BigInt& right) { return BigInt(left) ^ right; }
+template <size_t N> std::ostream& operator<< (std::ostream& out, const LinearSum<N>& sum) { return out << BigInt(sum); }
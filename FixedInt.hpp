@@ -0,0 +1,232 @@
+#pragma once
+#include <array>
+#include <span>
+#include "BigInt.hpp"
+#include "Mpn.hpp"
+
+// unsigned integer of exactly Bits bits (a multiple of 64, e.g. 128 to 4096) kept in an array inside the object, so
+// it never allocates. arithmetic wraps around modulo 2^Bits like the built-in unsigned types. it runs on the same
+// mpn kernels as BigInt with the length fixed at compile time: short widths inline the portable kernels, which the
+// compiler unrolls for the known length, and long widths go to the dispatched kernels for the running CPU.
+// everything except division is constexpr. converting to and from BigInt is one pass over the limbs
+template <size_t Bits>
+class FixedInt {
+	static_assert(Bits > 0 && Bits % 64 == 0, "FixedInt: Bits must be a positive multiple of 64");
+	template <size_t> friend class FixedInt;
+
+public:
+	static constexpr size_t LIMBS = Bits / BITS_IN_LIMB;
+
+private:
+	std::array<limb, LIMBS> digits{}; // least significant first
+
+	constexpr std::span<limb> span() { return digits; }
+	constexpr std::span<const limb> span() const { return digits; }
+
+public:
+	constexpr FixedInt() = default;
+
+	constexpr FixedInt(ulonglong value) {
+		for (size_t i = 0; i < LIMBS && i < ULONGLONG_BYTES / sizeof(limb); ++i) {
+			digits[i] = (limb)(value >> (i * BITS_IN_LIMB));
+		}
+	}
+
+	// value mod 2^Bits, a negative value becomes its two's complement
+	explicit FixedInt(const BigInt& value) {
+		const std::span<const limb> magnitude = value.limbs();
+		std::copy_n(magnitude.begin(), std::min(LIMBS, magnitude.size()), digits.begin());
+		if (value < 0) {
+			*this = -*this;
+		}
+	}
+
+	// other mod 2^Bits, zero-extended when Other < Bits
+	template <size_t Other>
+	constexpr explicit FixedInt(const FixedInt<Other>& other) {
+		std::copy_n(other.digits.begin(), std::min(LIMBS, FixedInt<Other>::LIMBS), digits.begin());
+	}
+
+	constexpr std::span<const limb> limbs() const { return digits; }
+
+	// *this * 2^bits as a LinearSum term, BigInt(x.scaled()) converts to BigInt and x.scaled() + y adds to one
+	LinearSum<1> scaled(size_t bits = 0) const {
+		return LinearSum<1>{{SumTerm{span(), false, bits}}};
+	}
+	BigInt to_bigint() const { return BigInt(scaled()); }
+	std::string to_string(unsigned base = 10) const { return to_bigint().to_string(base); }
+
+	constexpr size_t bit_length() const {
+		const size_t n = mpn::normalized_size(span());
+		return n == 0 ? 0 : (n - 1) * BITS_IN_LIMB + (BITS_IN_LIMB - std::countl_zero(digits[n - 1]));
+	}
+
+	constexpr size_t popcount() const {
+		size_t count = 0;
+		for (limb digit : digits) {
+			count += std::popcount(digit);
+		}
+		return count;
+	}
+
+	// the full 2 * Bits bit product. at runtime it goes through mpn::mul, so wide operands get karatsuba
+	constexpr FixedInt<2 * Bits> mul_wide(const FixedInt& right) const {
+		FixedInt<2 * Bits> product;
+		if (std::is_constant_evaluated()) {
+			for (size_t i = 0; i < LIMBS; ++i) {
+				product.digits[i + LIMBS] = mpn::addmul_1(product.span().subspan(i, LIMBS), span(), right.digits[i]);
+			}
+		} else {
+			mpn::mul(product.span(), span(), right.span());
+		}
+		return product;
+	}
+
+	// quotient and remainder through mpn::divrem like BigInt's division, not constexpr. throws std::domain_error
+	// if b is zero
+	static void divmod(const FixedInt& a, const FixedInt& b, FixedInt& quotient, FixedInt& remainder) {
+		const size_t m = mpn::normalized_size(a.span());
+		const size_t n = mpn::normalized_size(b.span());
+		if (n == 0) {
+			throw std::domain_error("FixedInt division by zero");
+		}
+		if (m < n || (m == n && mpn::cmp(a.span().first(n), b.span().first(n)) < 0)) {
+			remainder = a;
+			quotient = FixedInt();
+			return;
+		}
+		FixedInt q;
+		if (n == 1) {
+			const limb rem = mpn::divrem_1(q.span().first(m), a.span().first(m), b.digits[0]);
+			quotient = q;
+			remainder = FixedInt(rem);
+			return;
+		}
+
+		// normalize so the divisor's top bit is set, as BigInt::long_div does
+		const unsigned s = std::countl_zero(b.digits[n - 1]);
+		std::array<limb, LIMBS> v{};
+		std::array<limb, LIMBS + 1> u{};
+		mpn::lshift(std::span<limb>(v).first(n), b.span().first(n), s);
+		u[m] = mpn::lshift(std::span<limb>(u).first(m), a.span().first(m), s);
+		mpn::divrem(q.span().first(m - n + 1), std::span<limb>(u).first(m + 1), std::span<const limb>(v).first(n));
+		quotient = q;
+		remainder = FixedInt();
+		mpn::rshift(remainder.span().first(n), std::span<const limb>(u).first(n), s);
+	}
+
+	// arithmetic modulo 2^Bits
+	constexpr FixedInt operator+ (const FixedInt& right) const {
+		FixedInt sum;
+		mpn::add_n(sum.span(), span(), right.span());
+		return sum;
+	}
+
+	constexpr FixedInt operator- (const FixedInt& right) const {
+		FixedInt difference;
+		mpn::sub_n(difference.span(), span(), right.span());
+		return difference;
+	}
+
+	constexpr FixedInt operator- () const {
+		return FixedInt() - *this;
+	}
+
+	// only the low half of the product, row i of the long multiplication stops at limb LIMBS
+	constexpr FixedInt operator* (const FixedInt& right) const {
+		FixedInt product;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			if (right.digits[i] != 0) {
+				mpn::addmul_1(product.span().subspan(i), span().first(LIMBS - i), right.digits[i]);
+			}
+		}
+		return product;
+	}
+
+	FixedInt operator/ (const FixedInt& right) const {
+		FixedInt quotient, remainder;
+		divmod(*this, right, quotient, remainder);
+		return quotient;
+	}
+
+	FixedInt operator% (const FixedInt& right) const {
+		FixedInt quotient, remainder;
+		divmod(*this, right, quotient, remainder);
+		return remainder;
+	}
+
+	// bits shifted past either end are dropped
+	constexpr FixedInt operator<< (size_t bits) const {
+		FixedInt shifted;
+		const size_t limbs = bits / BITS_IN_LIMB;
+		if (limbs < LIMBS) {
+			mpn::lshift(shifted.span().subspan(limbs), span().first(LIMBS - limbs), bits % BITS_IN_LIMB);
+		}
+		return shifted;
+	}
+
+	constexpr FixedInt operator>> (size_t bits) const {
+		FixedInt shifted;
+		const size_t limbs = bits / BITS_IN_LIMB;
+		if (limbs < LIMBS) {
+			mpn::rshift(shifted.span().first(LIMBS - limbs), span().subspan(limbs), bits % BITS_IN_LIMB);
+		}
+		return shifted;
+	}
+
+	constexpr FixedInt operator& (const FixedInt& right) const {
+		FixedInt result;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			result.digits[i] = digits[i] & right.digits[i];
+		}
+		return result;
+	}
+
+	constexpr FixedInt operator| (const FixedInt& right) const {
+		FixedInt result;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			result.digits[i] = digits[i] | right.digits[i];
+		}
+		return result;
+	}
+
+	constexpr FixedInt operator^ (const FixedInt& right) const {
+		FixedInt result;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			result.digits[i] = digits[i] ^ right.digits[i];
+		}
+		return result;
+	}
+
+	constexpr FixedInt operator~ () const {
+		FixedInt result;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			result.digits[i] = ~digits[i];
+		}
+		return result;
+	}
+
+	constexpr FixedInt& operator+= (const FixedInt& right) { return *this = *this + right; }
+	constexpr FixedInt& operator-= (const FixedInt& right) { return *this = *this - right; }
+	constexpr FixedInt& operator*= (const FixedInt& right) { return *this = *this * right; }
+	FixedInt& operator/= (const FixedInt& right) { return *this = *this / right; }
+	FixedInt& operator%= (const FixedInt& right) { return *this = *this % right; }
+	constexpr FixedInt& operator<<= (size_t bits) { return *this = *this << bits; }
+	constexpr FixedInt& operator>>= (size_t bits) { return *this = *this >> bits; }
+	constexpr FixedInt& operator&= (const FixedInt& right) { return *this = *this & right; }
+	constexpr FixedInt& operator|= (const FixedInt& right) { return *this = *this | right; }
+	constexpr FixedInt& operator^= (const FixedInt& right) { return *this = *this ^ right; }
+
+	constexpr bool operator== (const FixedInt& right) const { return digits == right.digits; }
+	constexpr bool operator< (const FixedInt& right) const { return mpn::cmp(span(), right.span()) < 0; }
+	constexpr bool operator> (const FixedInt& right) const { return right < *this; }
+	constexpr bool operator<= (const FixedInt& right) const { return !(right < *this); }
+	constexpr bool operator>= (const FixedInt& right) const { return !(*this < right); }
+};
+
+typedef FixedInt<128> uint128;
+typedef FixedInt<256> uint256;
+typedef FixedInt<512> uint512;
+typedef FixedInt<1024> uint1024;
+typedef FixedInt<2048> uint2048;
+typedef FixedInt<4096> uint4096;
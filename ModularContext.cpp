@@ -0,0 +1,156 @@
+#include "../include/ModularContext.hpp"
+#include "../include/Mpn.hpp"
+#include "../include/Stats.hpp"
+
+/* ***************************************************
+ *            MODULAR CONTEXT METHODS               *
+ ***************************************************  */
+
+ModularContext::ModularContext(const BigInt &modulus)
+    : m(modulus), m_digits(modulus.digits.begin(), modulus.digits.end()), montgomery(modulus.digits[0] & 1), neg_m_inv(0) {
+    if (!modulus.positive || modulus == 0) {
+        throw std::domain_error("ModularContext: modulus must be positive");
+    }
+    if (montgomery) {
+        const size_t n = m_digits.size();
+        neg_m_inv = (limb)0 - mpn::binvert_1(m_digits[0]);
+        r2 = to_limbs(BigInt(1).shifted_left(2 * n * BITS_IN_LIMB));
+        one = to_limbs(BigInt(1).shifted_left(n * BITS_IN_LIMB));
+    }
+}
+
+const BigInt &ModularContext::modulus() const {
+    return m;
+}
+
+BigInt ModularContext::reduce(const BigInt &a) const {
+    BigInt r = a % m; // has the sign of a
+    if (!r.positive) {
+        r = r + m;
+    }
+    return r;
+}
+
+// a mod m as exactly n limbs
+std::vector<limb> ModularContext::to_limbs(const BigInt &a) const {
+    const BigInt r = reduce(a);
+    std::vector<limb> x(m_digits.size(), 0);
+    std::copy(r.digits.begin(), r.digits.end(), x.begin());
+    return x;
+}
+
+BigInt ModularContext::from_limbs(std::span<const limb> x) const {
+    return BigInt(BigInt::digit_vector(x.begin(), x.end()), true);
+}
+
+// r = a * b * BASE^-n mod m for a, b < m. product holds 2n limbs, scratch karatsuba_scratch_size(n), r may alias a or b
+void ModularContext::mont_mul(std::span<limb> r, std::span<const limb> a, std::span<const limb> b, std::span<limb> product, std::span<limb> scratch) const {
+    mpn::mul_n(product, a, b, scratch);
+    mpn::redc(r, product, m_digits, neg_m_inv);
+}
+
+// r = a^2 * BASE^-n mod m, like mont_mul
+void ModularContext::mont_sqr(std::span<limb> r, std::span<const limb> a, std::span<limb> product, std::span<limb> scratch) const {
+    mpn::sqr_n(product, a, scratch);
+    mpn::redc(r, product, m_digits, neg_m_inv);
+}
+
+// returns a * b mod m. montgomery multiplication leaves a factor BASE^-n behind, multiplying by r2 cancels it
+BigInt ModularContext::mulmod(const BigInt &a, const BigInt &b) const {
+    if (!montgomery) {
+        return reduce(a * b);
+    }
+    const size_t n = m_digits.size();
+    std::vector<limb> x = to_limbs(a), y = to_limbs(b);
+    std::vector<limb> product(2 * n), scratch(mpn::karatsuba_scratch_size(n));
+    mont_mul(x, x, y, product, scratch);
+    mont_mul(x, x, r2, product, scratch);
+    return from_limbs(x);
+}
+
+// returns a^2 mod m, see mulmod
+BigInt ModularContext::sqrmod(const BigInt &a) const {
+    if (!montgomery) {
+        return reduce(a.square());
+    }
+    const size_t n = m_digits.size();
+    std::vector<limb> x = to_limbs(a);
+    std::vector<limb> product(2 * n), scratch(mpn::karatsuba_scratch_size(n));
+    mont_sqr(x, x, product, scratch);
+    mont_mul(x, x, r2, product, scratch);
+    return from_limbs(x);
+}
+
+// returns base^exponent mod m. the exponent is cut into w-bit windows from the top, each window costs w squarings
+// and one multiplication by a precomputed base^window, complexity O(log(exponent)) modular multiplications
+BigInt ModularContext::powmod(const BigInt &base, const BigInt &exponent) const {
+    if (!exponent.positive) {
+        throw std::domain_error("ModularContext: negative exponent");
+    }
+    BIGINT_STAT_SCOPE(POWMOD, m_digits.size());
+    if (m == 1) {
+        return BigInt();
+    }
+    if (exponent == 0) {
+        return BigInt(1);
+    }
+    const std::span<const limb> e(exponent.digits.data(), exponent.digits.size());
+    const auto bit = [&](size_t i) { return (e[i / BITS_IN_LIMB] >> (i % BITS_IN_LIMB)) & 1; };
+    const size_t bits = exponent.bit_length();
+
+    if (!montgomery) { // left to right binary exponentiation with a division per step
+        const BigInt x = reduce(base);
+        BigInt result = x;
+        for (size_t i = bits - 1; i-- > 0;) {
+            result = result.square() % m;
+            if (bit(i)) {
+                result = result * x % m;
+            }
+        }
+        return result;
+    }
+
+    // wider windows need fewer multiplications but a 2^w entry table, these balance the two for the exponent size
+    const size_t w = bits <= 24 ? 2 : bits <= 96 ? 3 : bits <= 384 ? 4 : bits <= 1536 ? 5 : 6;
+    const size_t n = m_digits.size();
+    std::vector<limb> table(((size_t)1 << w) * n); // table[i] = base^i in montgomery form, n limbs each
+    std::vector<limb> acc(n), product(2 * n), scratch(mpn::karatsuba_scratch_size(n));
+    const auto entry = [&](size_t i) { return std::span<limb>(table).subspan(i * n, n); };
+    std::copy(one.begin(), one.end(), entry(0).begin());
+    const std::vector<limb> x = to_limbs(base);
+    mont_mul(entry(1), x, r2, product, scratch);
+    for (size_t i = 2; i < ((size_t)1 << w); ++i) {
+        mont_mul(entry(i), entry(i - 1), entry(1), product, scratch);
+    }
+
+    // the top window takes the leftover bits so the rest line up on multiples of w
+    const auto window = [&](size_t lo, size_t width) {
+        size_t value = 0;
+        for (size_t j = lo + width; j-- > lo;) {
+            value = value << 1 | bit(j);
+        }
+        return value;
+    };
+    size_t i = bits - ((bits - 1) % w + 1);
+    const std::span<const limb> top = entry(window(i, bits - i));
+    std::copy(top.begin(), top.end(), acc.begin());
+    while (i > 0) {
+        i -= w;
+        for (size_t j = 0; j < w; ++j) {
+            mont_sqr(acc, acc, product, scratch);
+        }
+        if (const size_t value = window(i, w)) {
+            mont_mul(acc, acc, entry(value), product, scratch);
+        }
+    }
+
+    // out of montgomery form: reducing acc itself divides by BASE^n once more
+    std::fill(product.begin(), product.end(), 0);
+    std::copy(acc.begin(), acc.end(), product.begin());
+    mpn::redc(acc, product, m_digits, neg_m_inv);
+    return from_limbs(acc);
+}
+
+BigInt ModularContext::inverse(const BigInt &a) const {
+    return BigInt::mod_inverse(a, m);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "BigInt.hpp"
+
+// arithmetic modulo one fixed modulus m, for running many multiplications and exponentiations against it. odd
+// moduli are reduced with montgomery multiplication: the parameters are computed once here, and powmod keeps its
+// numbers in montgomery form on plain limb vectors, so after one workspace allocation per call every step is a
+// multiplication plus a reduction with no division and no allocation. even moduli fall back to a division per step.
+// results are always in [0, m), operands may be any BigInt (they are reduced first)
+class ModularContext {
+private:
+	BigInt m;
+	std::vector<limb> m_digits; // n limbs
+	bool montgomery;            // m is odd
+	limb neg_m_inv;             // -m^-1 mod BASE
+	std::vector<limb> r2;       // BASE^(2n) mod m, converts into montgomery form
+	std::vector<limb> one;      // BASE^n mod m, 1 in montgomery form
+
+	std::vector<limb> to_limbs(const BigInt& a) const;
+	BigInt from_limbs(std::span<const limb> x) const;
+	void mont_mul(std::span<limb> r, std::span<const limb> a, std::span<const limb> b, std::span<limb> product, std::span<limb> scratch) const;
+	void mont_sqr(std::span<limb> r, std::span<const limb> a, std::span<limb> product, std::span<limb> scratch) const;
+
+public:
+	// m must be positive
+	explicit ModularContext(const BigInt& modulus);
+
+	const BigInt& modulus() const;
+
+	// a mod m in [0, m), also for negative a
+	BigInt reduce(const BigInt& a) const;
+
+	BigInt mulmod(const BigInt& a, const BigInt& b) const;
+	BigInt sqrmod(const BigInt& a) const;
+
+	// base^exponent mod m with fixed-window exponentiation, exponent must not be negative
+	BigInt powmod(const BigInt& base, const BigInt& exponent) const;
+
+	// a^-1 mod m in [0, m) by the extended gcd, throws std::domain_error if gcd(a, m) is not 1
+	BigInt inverse(const BigInt& a) const;
+};
@@ -0,0 +1,927 @@
+#include "../include/Mpn.hpp"
+#include "../include/ScratchArena.hpp"
+#include "../include/Stats.hpp"
+
+/* ***************************************************
+ *        NUMBER THEORETIC TRANSFORM HELPERS        *
+ ***************************************************  */
+
+namespace {
+
+std::shared_ptr<Executor> executor_owner;      // keeps the executor set through mpn::set_executor alive
+std::atomic<Executor *> current_executor(nullptr);
+
+// the executor to split a product of this size over, nullptr if it should stay on this thread
+Executor *parallel_executor(size_t size) {
+    Executor *executor = current_executor.load(std::memory_order_acquire);
+    return executor && size >= mpn::thresholds.parallel && executor->concurrency() > 1 ? executor : nullptr;
+}
+
+// runs f(lo, hi) over consecutive chunks of [0, n) no shorter than grain, spread over the executor if there is one
+template <typename F>
+void parallel_for(Executor *executor, size_t n, size_t grain, F f) {
+    const size_t chunks = executor ? std::min(4 * executor->concurrency(), n / grain) : 1;
+    if (chunks <= 1) {
+        f(0, n);
+        return;
+    }
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(chunks);
+    for (size_t c = 0; c < chunks; ++c) {
+        tasks.push_back([&f, lo = n * c / chunks, hi = n * (c + 1) / chunks] { f(lo, hi); });
+    }
+    executor->run(tasks);
+}
+
+const size_t NTT_GRAIN = (size_t)1 << 14; // butterflies or pointwise products per parallel chunk
+
+// computes b^e mod m with plain (non-Montgomery) arithmetic
+constexpr uint pow_mod(ulonglong b, ulonglong e, uint m) {
+    ulonglong result = 1;
+    b %= m;
+    for (; e > 0; e >>= 1) {
+        if (e & 1) {
+            result = result * b % m;
+        }
+        b = b * b % m;
+    }
+    return (uint)result;
+}
+
+// prime p = c * 2^k + 1 below 2^31 with primitive root g, multiplication is done in Montgomery form with R = 2^32
+struct NttPrime {
+    uint p;
+    uint g;
+    uint neg_p_inv; // -p^-1 mod R
+    uint r2;        // R^2 mod p
+
+    constexpr NttPrime(uint p_in, uint g_in) : p(p_in), g(g_in), neg_p_inv(0), r2(0) {
+        uint inv = p;
+        for (int i = 0; i < 5; ++i) {
+            inv *= 2 - p * inv; // newton iteration doubles the number of correct low bits
+        }
+        neg_p_inv = 0u - inv;
+        ulonglong r = ((ulonglong)1 << BITS_IN_UINT) % p;
+        r2 = (uint)(r * r % p);
+    }
+
+    // returns t * R^-1 mod p for t < p * R
+    uint reduce(ulonglong t) const {
+        uint m = (uint)t * neg_p_inv;
+        uint r = (uint)((t + (ulonglong)m * p) >> BITS_IN_UINT);
+        return r >= p ? r - p : r;
+    }
+    uint mul(uint a, uint b) const { return reduce((ulonglong)a * b); }
+    uint add(uint a, uint b) const { uint r = a + b; return r >= p ? r - p : r; }
+    uint sub(uint a, uint b) const { return a >= b ? a - b : a + p - b; }
+    uint to_mont(uint a) const { return mul(a % p, r2); }
+};
+
+constexpr NttPrime NTT_PRIMES[3] = {
+    NttPrime(2013265921, 31), // 15 * 2^27 + 1
+    NttPrime(469762049, 3),   // 7 * 2^26 + 1
+    NttPrime(754974721, 11),  // 45 * 2^24 + 1
+};
+
+// twiddle table in Montgomery form, roots[len + j] = w^j where w is a primitive (2*len)-th root of unity, for each power of two len < n
+std::vector<uint> ntt_roots(const NttPrime &prime, size_t n, bool inverse) {
+    std::vector<uint> roots(n);
+    const size_t half = n / 2;
+    uint w = pow_mod(prime.g, (prime.p - 1) / n, prime.p);
+    if (inverse) {
+        w = pow_mod(w, prime.p - 2, prime.p);
+    }
+    const uint w_mont = prime.to_mont(w);
+    roots[half] = prime.to_mont(1);
+    for (size_t j = 1; j < half; ++j) {
+        roots[half + j] = prime.mul(roots[half + j - 1], w_mont);
+    }
+    for (size_t len = half / 2; len > 0; len >>= 1) {
+        for (size_t j = 0; j < len; ++j) {
+            roots[len + j] = roots[2 * (len + j)]; // w_(2len)^j == w_(4len)^(2j)
+        }
+    }
+    return roots;
+}
+
+// runs one stage of a transform of length n, butterfly(i, j) combines a[i + j] and a[i + j + len] for each block
+// start i (a multiple of 2 * len) and offset j < len. the butterflies are independent, so the stage is split into
+// chunks for the executor: by blocks when there are many short ones, by offsets within each block otherwise
+template <typename Butterfly>
+void ntt_stage(Executor *executor, size_t n, size_t len, Butterfly butterfly) {
+    const size_t blocks = n / (2 * len);
+    if (!executor) { // plain loops, going through parallel_for keeps the compiler from inlining the butterfly
+        for (size_t i = 0; i < n; i += 2 * len) {
+            for (size_t j = 0; j < len; ++j) {
+                butterfly(i, j);
+            }
+        }
+    } else if (blocks >= len) {
+        parallel_for(executor, blocks, std::max<size_t>(NTT_GRAIN / len, 1), [&](size_t lo, size_t hi) {
+            for (size_t i = lo * 2 * len; i < hi * 2 * len; i += 2 * len) {
+                for (size_t j = 0; j < len; ++j) {
+                    butterfly(i, j);
+                }
+            }
+        });
+    } else {
+        parallel_for(executor, len, std::max<size_t>(NTT_GRAIN / blocks, 1), [&](size_t lo, size_t hi) {
+            for (size_t i = 0; i < n; i += 2 * len) {
+                for (size_t j = lo; j < hi; ++j) {
+                    butterfly(i, j);
+                }
+            }
+        });
+    }
+}
+
+// decimation-in-frequency transform, natural order in, bit-reversed order out
+void ntt_forward(std::vector<uint> &a, const NttPrime &prime, const std::vector<uint> &roots, Executor *executor) {
+    const size_t n = a.size();
+    uint *const data = a.data();
+    const NttPrime p = prime; // local copy, so stores into data cannot alias its fields
+    for (size_t len = n / 2; len > 0; len >>= 1) {
+        const uint *const w = roots.data() + len;
+        ntt_stage(executor, n, len, [=](size_t i, size_t j) {
+            uint u = data[i + j];
+            uint v = data[i + j + len];
+            data[i + j] = p.add(u, v);
+            data[i + j + len] = p.mul(p.sub(u, v), w[j]);
+        });
+    }
+}
+
+// decimation-in-time transform with inverse roots, bit-reversed order in, natural order out (unscaled)
+void ntt_inverse(std::vector<uint> &a, const NttPrime &prime, const std::vector<uint> &roots, Executor *executor) {
+    const size_t n = a.size();
+    uint *const data = a.data();
+    const NttPrime p = prime;
+    for (size_t len = 1; len < n; len <<= 1) {
+        const uint *const w = roots.data() + len;
+        ntt_stage(executor, n, len, [=](size_t i, size_t j) {
+            uint u = data[i + j];
+            uint v = p.mul(data[i + j + len], w[j]);
+            data[i + j] = p.add(u, v);
+            data[i + j + len] = p.sub(u, v);
+        });
+    }
+}
+
+// true when a and b are the same limbs, so a product of them is a squaring
+bool same_operand(std::span<const limb> a, std::span<const limb> b) {
+    return a.data() == b.data() && a.size() == b.size();
+}
+
+// i-th 32-bit coefficient of a, the transform works on 32-bit pieces so 64-bit limbs are split in two
+uint ntt_coefficient(std::span<const limb> a, size_t i) {
+    return (uint)(a[i / UINTS_IN_LIMB] >> (BITS_IN_UINT * (i % UINTS_IN_LIMB)));
+}
+
+// cyclic convolution of a and b modulo prime, n is a power of two >= the number of 32-bit coefficients in a * b
+// (a squaring, when a and b are the same span, transforms its operand once)
+std::vector<uint> ntt_convolve(std::span<const limb> a, std::span<const limb> b, size_t n, const NttPrime &prime, Executor *executor) {
+    const bool square = same_operand(a, b);
+    std::vector<uint> fa(n, 0), fb(square ? 0 : n, 0);
+    for (size_t i = 0; i < a.size() * UINTS_IN_LIMB; ++i) {
+        fa[i] = ntt_coefficient(a, i) % prime.p;
+    }
+    for (size_t i = 0; i < fb.size() && i < b.size() * UINTS_IN_LIMB; ++i) {
+        fb[i] = ntt_coefficient(b, i) % prime.p;
+    }
+    const std::vector<uint> roots = ntt_roots(prime, n, false);
+    if (square) {
+        ntt_forward(fa, prime, roots, executor);
+    } else if (executor) {
+        const std::function<void()> transforms[] = {
+            [&] { ntt_forward(fa, prime, roots, executor); },
+            [&] { ntt_forward(fb, prime, roots, executor); },
+        };
+        executor->run(transforms);
+    } else {
+        ntt_forward(fa, prime, roots, nullptr);
+        ntt_forward(fb, prime, roots, nullptr);
+    }
+
+    // inputs were never converted to Montgomery form, so each pointwise product carries an extra R^-1.
+    // scaling by n^-1 * R^2 cancels it and the 1/n of the inverse transform at the same time
+    const uint n_inv = prime.p - (uint)((prime.p - 1) / n);
+    const uint scale = prime.to_mont(prime.to_mont(n_inv));
+    const std::vector<uint> &other = square ? fa : fb;
+    parallel_for(executor, n, NTT_GRAIN, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            fa[i] = prime.mul(prime.mul(fa[i], other[i]), scale);
+        }
+    });
+    ntt_inverse(fa, prime, ntt_roots(prime, n, true), executor);
+    return fa;
+}
+
+/* ***************************************************
+ *                TOOM-COOK HELPERS                 *
+ ***************************************************  */
+
+// signed multi-limb number for the evaluation and interpolation steps of toom-cook, the magnitude never has
+// leading zero limbs (zero is an empty magnitude). magnitudes live in the thread's scratch arena, inside the Frame
+// of the toom level that made them
+struct ToomValue {
+    std::pmr::vector<limb> mag;
+    bool negative = false;
+
+    ToomValue() : mag(&ScratchArena::local()) {}
+    explicit ToomValue(std::span<const limb> x)
+        : mag(x.begin(), x.begin() + mpn::normalized_size(x), &ScratchArena::local()) {}
+
+    void normalize() {
+        mag.resize(mpn::normalized_size(mag));
+        if (mag.empty()) {
+            negative = false;
+        }
+    }
+};
+
+// x + y if y_negative is y's sign, x - y if it is flipped
+ToomValue toom_add(const ToomValue &x, const ToomValue &y, bool y_negative) {
+    const ToomValue &big = x.mag.size() >= y.mag.size() ? x : y;
+    const ToomValue &small = x.mag.size() >= y.mag.size() ? y : x;
+    const bool big_negative = &big == &x ? x.negative : y_negative;
+    const bool small_negative = &big == &x ? y_negative : x.negative;
+    ToomValue sum;
+    sum.mag.resize(big.mag.size() + 1);
+    const std::span<limb> low = std::span<limb>(sum.mag).first(big.mag.size());
+    if (big_negative == small_negative) {
+        sum.mag.back() = mpn::add(low, big.mag, small.mag);
+        sum.negative = big_negative;
+    } else {
+        const bool less = mpn::sub_abs(low, big.mag, small.mag); // |big| - |small|, or the reverse if that is larger
+        sum.negative = less ? small_negative : big_negative;
+    }
+    sum.normalize();
+    return sum;
+}
+
+ToomValue operator+(const ToomValue &x, const ToomValue &y) { return toom_add(x, y, y.negative); }
+ToomValue operator-(const ToomValue &x, const ToomValue &y) { return toom_add(x, y, !y.negative); }
+
+// x * m for a single limb m
+ToomValue operator*(const ToomValue &x, limb m) {
+    ToomValue product;
+    product.mag.resize(x.mag.size() + 1);
+    product.mag.back() = mpn::mul_1(std::span<limb>(product.mag).first(x.mag.size()), x.mag, m);
+    product.negative = x.negative;
+    product.normalize();
+    return product;
+}
+
+// x / 2^bits for bits < BITS_IN_LIMB where the division is exact
+void toom_shift_down(ToomValue &x, unsigned bits) {
+    if (!x.mag.empty()) {
+        mpn::rshift(x.mag, x.mag, bits);
+        x.normalize();
+    }
+}
+
+// x / d for odd d where the division is exact
+void toom_divexact(ToomValue &x, limb d) {
+    mpn::divexact_1(x.mag, x.mag, d);
+    x.normalize();
+}
+
+// splits a into parts of k limbs (least significant first), the top part takes what is left
+std::vector<std::span<const limb>> toom_split(std::span<const limb> a, size_t parts, size_t k) {
+    std::vector<std::span<const limb>> pieces;
+    for (size_t i = 0; i + 1 < parts; ++i) {
+        pieces.push_back(a.subspan(i * k, k));
+    }
+    pieces.push_back(a.subspan((parts - 1) * k));
+    return pieces;
+}
+
+// value *= factor, then value += part, in place
+void toom_horner_step(std::pmr::vector<limb> &value, limb factor, std::span<const limb> part) {
+    const limb carry = mpn::mul_1(value, value, factor);
+    if (carry) {
+        value.push_back(carry);
+    }
+    if (value.size() < part.size()) {
+        value.resize(part.size(), 0);
+    }
+    if (mpn::add(value, value, part)) {
+        value.push_back(1);
+    }
+}
+
+// sum of parts[i] * factor^((i - first)/2) over every other part from first, by horner's rule
+ToomValue toom_evaluate_alternate(const std::vector<std::span<const limb>> &parts, size_t first, limb factor) {
+    size_t i = first + (parts.size() - 1 - first) / 2 * 2;
+    std::pmr::vector<limb> value(parts[i].begin(), parts[i].end(), &ScratchArena::local());
+    value.reserve(parts[first].size() + 2);
+    while (i > first) {
+        i -= 2;
+        toom_horner_step(value, factor, parts[i]);
+    }
+    return ToomValue(value);
+}
+
+// values of the polynomial with coefficients parts (least significant first) at x and -x. both share the even
+// and odd halves of the sum, p(x) = even + odd and p(-x) = even - odd
+void toom_evaluate(const std::vector<std::span<const limb>> &parts, limb x, ToomValue &plus, ToomValue &minus) {
+    const ToomValue even = toom_evaluate_alternate(parts, 0, x * x);
+    const ToomValue odd = toom_evaluate_alternate(parts, 1, x * x) * x;
+    plus = even + odd;
+    minus = even - odd;
+}
+
+// value of the polynomial at x alone, by horner's rule from the top coefficient, for a point whose negative is not
+// needed
+ToomValue toom_evaluate_at(const std::vector<std::span<const limb>> &parts, limb x) {
+    std::pmr::vector<limb> value(parts.back().begin(), parts.back().end(), &ScratchArena::local());
+    value.reserve(parts.front().size() + 2);
+    for (size_t i = parts.size() - 1; i-- > 0;) {
+        toom_horner_step(value, x, parts[i]);
+    }
+    return ToomValue(value);
+}
+
+// 2^d times the value of the degree d polynomial at 1/2, i.e. the reversed coefficients evaluated at 2
+ToomValue toom_evaluate_half(const std::vector<std::span<const limb>> &parts) {
+    std::pmr::vector<limb> value(parts.front().begin(), parts.front().end(), &ScratchArena::local());
+    value.reserve(parts.front().size() + 2);
+    for (size_t i = 1; i < parts.size(); ++i) {
+        toom_horner_step(value, 2, parts[i]);
+    }
+    return ToomValue(value);
+}
+
+// computes the point products, independently of each other, on the executor when the product is big enough.
+// they are squarings when x and y are the same values. the products are sized here, in this thread's arena, so a
+// task running on another thread only writes into them and its own arena keeps nothing past the task
+void toom_products(std::vector<ToomValue> &products, const std::vector<ToomValue> &x, const std::vector<ToomValue> &y, size_t n) {
+    products.resize(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        const bool zero = x[i].mag.empty() || y[i].mag.empty();
+        products[i].mag.resize(zero ? 0 : x[i].mag.size() + y[i].mag.size());
+        products[i].negative = x[i].negative != y[i].negative;
+    }
+    const auto product = [&](size_t i) {
+        if (products[i].mag.empty()) {
+            return;
+        }
+        if (&x == &y) {
+            mpn::sqr(products[i].mag, x[i].mag);
+        } else {
+            mpn::mul(products[i].mag, x[i].mag, y[i].mag);
+        }
+        products[i].normalize(); // only shrinks, no allocation
+    };
+    if (Executor *executor = parallel_executor(n)) {
+        std::vector<std::function<void()>> tasks;
+        for (size_t i = 0; i < x.size(); ++i) {
+            tasks.push_back([&, i] { product(i); });
+        }
+        executor->run(tasks);
+    } else {
+        for (size_t i = 0; i < x.size(); ++i) {
+            product(i);
+        }
+    }
+}
+
+// r = sum of coefficients[i] * BASE^(i*k), every coefficient is non-negative and the sum fits in r
+void toom_recompose(std::span<limb> r, std::initializer_list<std::reference_wrapper<const ToomValue>> coefficients, size_t k) {
+    std::fill(r.begin(), r.end(), 0);
+    size_t i = 0;
+    for (const ToomValue &coefficient : coefficients) {
+        const std::span<limb> window = r.subspan(i++ * k);
+        mpn::add(window, window, coefficient.mag);
+    }
+}
+
+/* ***************************************************
+ *           BURNIKEL-ZIEGLER HELPERS               *
+ ***************************************************  */
+
+void bz_div_3n_2n(std::span<limb> q, std::span<limb> a, std::span<const limb> b);
+
+// q = a / b for a 2n-limb a and an n-limb normalized b with a.last(n) < b, the remainder is left in a.first(n) and
+// the rest of a is clobbered. odd or short blocks go to the schoolbook division
+void bz_div_2n_1n(std::span<limb> q, std::span<limb> a, std::span<const limb> b) {
+    const size_t n = b.size();
+    if (n % 2 || n < mpn::thresholds.burnikel_ziegler) {
+        mpn::divrem_basecase(q, a, b);
+        return;
+    }
+    const size_t half = n / 2;
+    bz_div_3n_2n(q.subspan(half), a.subspan(half, 3 * half), b); // top three quarters of a
+    bz_div_3n_2n(q.first(half), a.first(3 * half), b);           // their remainder and the last quarter
+}
+
+// q = a / b for a 3k-limb a and a 2k-limb normalized b with a.last(2k) < b, the remainder is left in a.first(2k)
+// and the rest of a is clobbered. the top k limbs of the quotient are estimated from b's top half, which is at
+// most two too big, then corrected against the low half
+void bz_div_3n_2n(std::span<limb> q, std::span<limb> a, std::span<const limb> b) {
+    const size_t k = q.size();
+    const std::span<const limb> b1 = b.subspan(k), b2 = b.first(k);
+    if (mpn::cmp(a.subspan(2 * k), b1) < 0) {
+        bz_div_2n_1n(q, a.subspan(k), b1); // r1 lands in a[k, 2k)
+        a[2 * k] = 0;
+    } else { // a's top k limbs equal b1, the quotient block saturates at BASE^k - 1 and r1 = a12 - b1*BASE^k + b1
+        std::fill(q.begin(), q.end(), ~(limb)0);
+        std::fill(a.begin() + 2 * k, a.end(), 0);
+        a[2 * k] = mpn::add_n(a.subspan(k, k), a.subspan(k, k), b1);
+    }
+
+    // remainder = r1*BASE^k + a3 - q*b2, held in 2k limbs plus the top carry at a[2k]
+    ScratchArena::Frame frame;
+    const std::span<limb> d = frame.allocate<limb>(2 * k);
+    mpn::mul_n(d, q, b2, frame.allocate<limb>(mpn::karatsuba_scratch_size(k)));
+    const std::span<limb> r = a.first(2 * k + 1);
+    limb borrow = mpn::sub(r, r, d);
+    while (borrow) {
+        borrow -= mpn::add(r, r, b);
+        mpn::sub_1(q, q, 1);
+    }
+}
+
+} // namespace
+
+/* ***************************************************
+ *                 MPN ALGORITHMS                   *
+ ***************************************************  */
+
+Thresholds mpn::thresholds;
+
+void mpn::set_executor(std::shared_ptr<Executor> executor) {
+    current_executor.store(executor.get(), std::memory_order_release);
+    executor_owner = std::move(executor);
+}
+
+Executor *mpn::get_executor() {
+    return current_executor.load(std::memory_order_acquire);
+}
+
+void mpn::mul_basecase(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+    BIGINT_STAT_SCOPE(MUL_BASECASE, std::max(a.size(), b.size()));
+    const size_t a_size = a.size();
+    r[a_size] = mul_1(r.first(a_size), a, b[0]);
+    for (size_t i = 1; i < b.size(); ++i) { // keep running sum of a * b[i] shifted by i limbs instead of storing rows
+        r[a_size + i] = addmul_1(r.subspan(i, a_size), a, b[i]);
+    }
+}
+
+// covers both mul_karatsuba and sqr_karatsuba, whichever of them recurses deeper
+size_t mpn::karatsuba_scratch_size(size_t n) {
+    if (n < std::min(thresholds.karatsuba, thresholds.sqr_karatsuba)) {
+        return 0;
+    }
+    const size_t m = (n + 1) / 2;
+    return 4 * m + std::max(karatsuba_scratch_size(m), 2 * m + 1);
+}
+
+void mpn::mul_karatsuba(std::span<limb> r, std::span<const limb> a, std::span<const limb> b, std::span<limb> scratch) {
+    const size_t n = a.size();
+    if (n < thresholds.karatsuba) {
+        mul_basecase(r, a, b);
+        return;
+    }
+    BIGINT_STAT_SCOPE(MUL_KARATSUBA, n);
+
+    // x = a1*BASE^m + a0 and y = b1*BASE^m + b0, the low halves get the extra limb when n is odd
+    const size_t m = (n + 1) / 2;
+    const std::span<const limb> a0 = a.first(m), a1 = a.subspan(m);
+    const std::span<const limb> b0 = b.first(m), b1 = b.subspan(m);
+    const std::span<limb> a_diff = scratch.first(m);
+    const std::span<limb> b_diff = scratch.subspan(m, m);
+    const std::span<limb> t = scratch.subspan(2 * m, 2 * m);
+    const std::span<limb> rest = scratch.subspan(4 * m);
+
+    // t = |a0 - a1| * |b0 - b1| keeps every operand at m limbs (no carries from a0 + a1)
+    const bool t_negative = sub_abs(a_diff, a0, a1) != sub_abs(b_diff, b0, b1);
+    if (Executor *executor = parallel_executor(n)) {
+        // the three products are independent, the two extra ones get scratch of their own from the arena of the
+        // thread that runs them
+        const std::function<void()> products[] = {
+            [&] { mul_n(t, a_diff, b_diff, rest); },
+            [&] {
+                ScratchArena::Frame frame;
+                mul_n(r.first(2 * m), a0, b0, frame.allocate<limb>(karatsuba_scratch_size(m)));
+            },
+            [&] {
+                ScratchArena::Frame frame;
+                mul_n(r.subspan(2 * m), a1, b1, frame.allocate<limb>(karatsuba_scratch_size(m)));
+            },
+        };
+        executor->run(products);
+    } else {
+        mul_n(t, a_diff, b_diff, rest);
+        mul_n(r.first(2 * m), a0, b0, rest);
+        mul_n(r.subspan(2 * m), a1, b1, rest);
+    }
+
+    // a0*b1 + a1*b0 = a0*b0 + a1*b1 - (a0 - a1)(b0 - b1), added in at BASE^m
+    const std::span<limb> middle = rest.first(2 * m + 1);
+    middle[2 * m] = add(middle.first(2 * m), r.first(2 * m), r.subspan(2 * m));
+    if (t_negative) {
+        middle[2 * m] += add_n(middle.first(2 * m), middle.first(2 * m), t);
+    } else {
+        middle[2 * m] -= sub_n(middle.first(2 * m), middle.first(2 * m), t);
+    }
+    add(r.subspan(m), r.subspan(m), middle);
+}
+
+void mpn::sqr_basecase(std::span<limb> r, std::span<const limb> a) {
+    BIGINT_STAT_SCOPE(SQR_BASECASE, a.size());
+    const size_t n = a.size();
+    // each cross product a[i]*a[j] with i < j appears twice in the square, so sum them once and double the sum
+    r[0] = 0;
+    r[n] = mul_1(r.subspan(1, n - 1), a.subspan(1), a[0]);
+    for (size_t i = 1; i + 1 < n; ++i) {
+        r[n + i] = addmul_1(r.subspan(2 * i + 1, n - 1 - i), a.subspan(i + 1), a[i]);
+    }
+    r[2 * n - 1] = 0;
+    lshift(r, r, 1); // the cross products sum to less than BASE^(2n) / 2, nothing shifts out
+
+    // then add the squares a[i]^2 on the diagonal
+    limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const dlimb square = (dlimb)a[i] * a[i];
+        dlimb sum = (dlimb)r[2 * i] + (limb)square + carry;
+        r[2 * i] = (limb)sum;
+        sum = (dlimb)r[2 * i + 1] + (limb)(square >> BITS_IN_LIMB) + (sum >> BITS_IN_LIMB);
+        r[2 * i + 1] = (limb)sum;
+        carry = (limb)(sum >> BITS_IN_LIMB);
+    }
+}
+
+void mpn::sqr_karatsuba(std::span<limb> r, std::span<const limb> a, std::span<limb> scratch) {
+    const size_t n = a.size();
+    if (n < thresholds.sqr_karatsuba) {
+        sqr_basecase(r, a);
+        return;
+    }
+    BIGINT_STAT_SCOPE(SQR_KARATSUBA, n);
+
+    // x = a1*BASE^m + a0, so x^2 = a1^2*BASE^2m + (a0^2 + a1^2 - (a0 - a1)^2)*BASE^m + a0^2 with three squarings
+    const size_t m = (n + 1) / 2;
+    const std::span<const limb> a0 = a.first(m), a1 = a.subspan(m);
+    const std::span<limb> a_diff = scratch.first(m);
+    const std::span<limb> t = scratch.subspan(2 * m, 2 * m);
+    const std::span<limb> rest = scratch.subspan(4 * m);
+    sub_abs(a_diff, a0, a1);
+    if (Executor *executor = parallel_executor(n)) {
+        const std::function<void()> squares[] = {
+            [&] { sqr_n(t, a_diff, rest); },
+            [&] {
+                ScratchArena::Frame frame;
+                sqr_n(r.first(2 * m), a0, frame.allocate<limb>(karatsuba_scratch_size(m)));
+            },
+            [&] {
+                ScratchArena::Frame frame;
+                sqr_n(r.subspan(2 * m), a1, frame.allocate<limb>(karatsuba_scratch_size(m)));
+            },
+        };
+        executor->run(squares);
+    } else {
+        sqr_n(t, a_diff, rest);
+        sqr_n(r.first(2 * m), a0, rest);
+        sqr_n(r.subspan(2 * m), a1, rest);
+    }
+
+    const std::span<limb> middle = rest.first(2 * m + 1);
+    middle[2 * m] = add(middle.first(2 * m), r.first(2 * m), r.subspan(2 * m));
+    middle[2 * m] -= sub_n(middle.first(2 * m), middle.first(2 * m), t);
+    add(r.subspan(m), r.subspan(m), middle);
+}
+
+// splits both operands into three k-limb parts, x = a2*B^2 + a1*B + a0 with B = BASE^k, and multiplies the
+// polynomials through their values at 0, 1, -1, 2 and infinity. with c0..c4 the product's coefficients:
+//   c0 = r(0), c4 = r(inf), c2 = (r(1) + r(-1))/2 - c0 - c4
+//   o = (r(1) - r(-1))/2 = c1 + c3, t = (r(2) - c0 - 4*c2 - 16*c4)/2 = c1 + 4*c3
+//   c3 = (t - o)/3, c1 = o - c3
+void mpn::mul_toom3(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+    const size_t n = a.size();
+    BIGINT_STAT_SCOPE(MUL_TOOM3, n);
+    const size_t k = (n + 2) / 3;
+    ScratchArena::Frame frame; // every ToomValue of this level is freed on return
+    const std::vector<std::span<const limb>> a_parts = toom_split(a, 3, k), b_parts = toom_split(b, 3, k);
+    const bool square = same_operand(a, b); // a squaring evaluates its operand once
+    std::vector<ToomValue> x(5), y(square ? 0 : 5);
+    for (auto [parts, values] : { std::pair(&a_parts, &x), std::pair(&b_parts, &y) }) {
+        if (values->empty()) {
+            continue;
+        }
+        (*values)[0] = ToomValue((*parts)[0]);
+        toom_evaluate(*parts, 1, (*values)[1], (*values)[2]);
+        (*values)[3] = toom_evaluate_at(*parts, 2);
+        (*values)[4] = ToomValue((*parts)[2]);
+    }
+    std::vector<ToomValue> p;
+    toom_products(p, x, square ? x : y, n);
+    const ToomValue &r0 = p[0], &r1 = p[1], &r_minus1 = p[2], &r2 = p[3], &r_inf = p[4];
+
+    ToomValue c2 = r1 + r_minus1;
+    toom_shift_down(c2, 1);
+    c2 = c2 - r0 - r_inf;
+    ToomValue odd = r1 - r_minus1;
+    toom_shift_down(odd, 1);
+    ToomValue t = r2 - r0 - c2 * 4 - r_inf * 16;
+    toom_shift_down(t, 1);
+    ToomValue c3 = t - odd;
+    toom_divexact(c3, 3);
+    const ToomValue c1 = odd - c3;
+    toom_recompose(r, { r0, c1, c2, c3, r_inf }, k);
+}
+
+// splits both operands into four k-limb parts and multiplies the degree 3 polynomials through their values at
+// 0, 1, -1, 2, -2, 1/2 and infinity (the point 1/2 scaled by 2^3 per operand so it stays integral). with
+// c0..c6 the product's coefficients, c0 = r(0) and c6 = r(inf), and the even and odd parts separate:
+//   e1 = (r(1) + r(-1))/2 - c0 - c6 = c2 + c4, e2 = ((r(2) + r(-2))/2 - c0 - 64*c6)/4 = c2 + 4*c4
+//   o1 = (r(1) - r(-1))/2 = c1 + c3 + c5, o2 = (r(2) - r(-2))/4 = c1 + 4*c3 + 16*c5
+//   h = (64*r(1/2) - 64*c0 - 16*c2 - 4*c4 - c6)/2 = 16*c1 + 4*c3 + c5
+// which give c4 = (e2 - e1)/3, c2 = e1 - c4, u = (o2 - o1)/3 = c3 + 5*c5, v = (16*o1 - h)/3 = 4*c3 + 5*c5,
+// c3 = (v - u)/3, c5 = (u - c3)/5 and c1 = o1 - c3 - c5
+void mpn::mul_toom4(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+    const size_t n = a.size();
+    BIGINT_STAT_SCOPE(MUL_TOOM4, n);
+    const size_t k = (n + 3) / 4;
+    ScratchArena::Frame frame;
+    const std::vector<std::span<const limb>> a_parts = toom_split(a, 4, k), b_parts = toom_split(b, 4, k);
+    const bool square = same_operand(a, b);
+    std::vector<ToomValue> x(7), y(square ? 0 : 7);
+    for (auto [parts, values] : { std::pair(&a_parts, &x), std::pair(&b_parts, &y) }) {
+        if (values->empty()) {
+            continue;
+        }
+        (*values)[0] = ToomValue((*parts)[0]);
+        toom_evaluate(*parts, 1, (*values)[1], (*values)[2]);
+        toom_evaluate(*parts, 2, (*values)[3], (*values)[4]);
+        (*values)[5] = toom_evaluate_half(*parts);
+        (*values)[6] = ToomValue((*parts)[3]);
+    }
+    std::vector<ToomValue> p;
+    toom_products(p, x, square ? x : y, n);
+    const ToomValue &r0 = p[0], &r1 = p[1], &r_minus1 = p[2], &r2 = p[3], &r_minus2 = p[4], &r_half = p[5], &r_inf = p[6];
+
+    ToomValue e1 = r1 + r_minus1;
+    toom_shift_down(e1, 1);
+    e1 = e1 - r0 - r_inf;
+    ToomValue e2 = r2 + r_minus2;
+    toom_shift_down(e2, 1);
+    e2 = e2 - r0 - r_inf * 64;
+    toom_shift_down(e2, 2);
+    ToomValue c4 = e2 - e1;
+    toom_divexact(c4, 3);
+    const ToomValue c2 = e1 - c4;
+
+    ToomValue o1 = r1 - r_minus1;
+    toom_shift_down(o1, 1);
+    ToomValue o2 = r2 - r_minus2;
+    toom_shift_down(o2, 2);
+    ToomValue h = r_half - r0 * 64 - c2 * 16 - c4 * 4 - r_inf;
+    toom_shift_down(h, 1);
+    ToomValue u = o2 - o1;
+    toom_divexact(u, 3);
+    ToomValue v = o1 * 16 - h;
+    toom_divexact(v, 3);
+    ToomValue c3 = v - u;
+    toom_divexact(c3, 3);
+    ToomValue c5 = u - c3;
+    toom_divexact(c5, 5);
+    const ToomValue c1 = o1 - c3 - c5;
+    toom_recompose(r, { r0, c1, c2, c3, c4, c5, r_inf }, k);
+}
+
+// convolves a and b modulo three primes, then recombines the convolution with the chinese remainder theorem
+void mpn::mul_ntt(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+    BIGINT_STAT_SCOPE(MUL_NTT, std::max(a.size(), b.size()));
+    const size_t result_size = (a.size() + b.size()) * UINTS_IN_LIMB; // in 32-bit coefficients
+    const size_t n = std::bit_ceil(result_size);
+
+    // the three convolutions are independent, and so are the transforms inside each of them
+    std::vector<uint> residues[3];
+    Executor *executor = parallel_executor(result_size);
+    if (executor) {
+        const std::function<void()> convolutions[] = {
+            [&] { residues[0] = ntt_convolve(a, b, n, NTT_PRIMES[0], executor); },
+            [&] { residues[1] = ntt_convolve(a, b, n, NTT_PRIMES[1], executor); },
+            [&] { residues[2] = ntt_convolve(a, b, n, NTT_PRIMES[2], executor); },
+        };
+        executor->run(convolutions);
+    } else {
+        for (int k = 0; k < 3; ++k) {
+            residues[k] = ntt_convolve(a, b, n, NTT_PRIMES[k], nullptr);
+        }
+    }
+
+    // garner's algorithm: x = v1 + p1*v2 + p1*p2*v3, each convolution term is below p1*p2*p3 (~2^89)
+    const ulonglong p1 = NTT_PRIMES[0].p;
+    const ulonglong p2 = NTT_PRIMES[1].p;
+    const ulonglong p3 = NTT_PRIMES[2].p;
+    const ulonglong p1_inv_mod_p2 = pow_mod(p1, p2 - 2, (uint)p2);
+    const ulonglong p1_inv_mod_p3 = pow_mod(p1, p3 - 2, (uint)p3);
+    const ulonglong p2_inv_mod_p3 = pow_mod(p2, p3 - 2, (uint)p3);
+    const ulonglong p1p2 = p1 * p2;
+    const ulonglong p1p2_lo = (uint)p1p2;
+    const ulonglong p1p2_hi = p1p2 >> BITS_IN_UINT;
+
+    ulonglong carry = 0;
+    for (size_t i = 0; i < result_size; ++i) {
+        const ulonglong v1 = residues[0][i];
+        const ulonglong v2 = (residues[1][i] + p2 - v1 % p2) * p1_inv_mod_p2 % p2;
+        const ulonglong v3 = ((residues[2][i] + p3 - v1 % p3) * p1_inv_mod_p3 % p3 + p3 - v2 % p3) * p2_inv_mod_p3 % p3;
+
+        const ulonglong low = v1 + p1 * v2; // < 2^63
+        const ulonglong mid = p1p2_lo * v3; // p1*p2*v3 = mid + high * 2^32
+        const ulonglong high = p1p2_hi * v3;
+        const ulonglong true_add = (ulonglong)(uint)low + (uint)mid + (uint)carry;
+        const limb coefficient = (uint)true_add;
+        if (i % UINTS_IN_LIMB == 0) {
+            r[i / UINTS_IN_LIMB] = coefficient;
+        } else {
+            r[i / UINTS_IN_LIMB] |= coefficient << (BITS_IN_UINT * (i % UINTS_IN_LIMB));
+        }
+        carry = (true_add >> BITS_IN_UINT) + (low >> BITS_IN_UINT) + (mid >> BITS_IN_UINT) + high + (carry >> BITS_IN_UINT);
+    }
+}
+
+void mpn::mul(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+    if (same_operand(a, b)) {
+        sqr(r, a);
+        return;
+    }
+    if (a.size() < b.size()) { // want the longer operand on top
+        std::swap(a, b);
+    }
+    const size_t n = a.size();
+    if (b.size() >= thresholds.ntt && r.size() <= NTT_MAX_LENGTH) {
+        mul_ntt(r, a, b);
+        return;
+    }
+    if (b.size() < thresholds.karatsuba) {
+        mul_basecase(r, a, b);
+        return;
+    }
+
+    const size_t m = b.size();
+    ScratchArena::Frame frame;
+    const std::span<limb> scratch = frame.allocate<limb>(karatsuba_scratch_size(m) + (m < n ? 2 * m : 0));
+    if (m == n) {
+        mul_n(r, a, b, scratch);
+        return;
+    }
+
+    // unbalanced: slice a into m-limb blocks, multiply each with the balanced algorithms and add it in at the
+    // block's offset, so the cost grows with n/m balanced m*m products instead of one padded n*n product
+    const std::span<limb> product = scratch.first(2 * m);
+    const std::span<limb> balanced_scratch = scratch.subspan(2 * m);
+    mul_n(r.first(2 * m), a.first(m), b, balanced_scratch);
+    for (size_t offset = m; offset < n; offset += m) {
+        const size_t len = std::min(m, n - offset);
+        const std::span<const limb> block = a.subspan(offset, len);
+        if (len == m) {
+            mul_n(product, block, b, balanced_scratch);
+        } else {
+            mul(product.first(m + len), b, block); // the short tail block
+        }
+        // r[offset, offset + m) holds the top half of the previous block's product, the rest is still unset
+        const limb carry = mpn::add(r.subspan(offset, m), r.subspan(offset, m), product.first(m));
+        std::copy(product.begin() + m, product.begin() + m + len, r.begin() + offset + m);
+        mpn::add_1(r.subspan(offset + m, len), r.subspan(offset + m, len), carry);
+    }
+}
+
+void mpn::mul_n(std::span<limb> r, std::span<const limb> a, std::span<const limb> b, std::span<limb> scratch) {
+    const size_t n = a.size();
+    if (n < thresholds.karatsuba) {
+        mul_basecase(r, a, b); // karatsuba overhead not worth it, just do long multiplication
+    } else if (n >= thresholds.ntt && 2 * n <= NTT_MAX_LENGTH) {
+        mul_ntt(r, a, b);
+    } else if (n < thresholds.toom3) {
+        mul_karatsuba(r, a, b, scratch);
+    } else if (n < thresholds.toom4) {
+        mul_toom3(r, a, b);
+    } else {
+        mul_toom4(r, a, b); // also splits products too long for the transform until they fit
+    }
+}
+
+void mpn::sqr_n(std::span<limb> r, std::span<const limb> a, std::span<limb> scratch) {
+    const size_t n = a.size();
+    if (n < thresholds.sqr_karatsuba) {
+        sqr_basecase(r, a);
+    } else if (n >= thresholds.ntt && 2 * n <= NTT_MAX_LENGTH) {
+        mul_ntt(r, a, a);
+    } else if (n < thresholds.toom3) {
+        sqr_karatsuba(r, a, scratch);
+    } else if (n < thresholds.toom4) {
+        mul_toom3(r, a, a);
+    } else {
+        mul_toom4(r, a, a);
+    }
+}
+
+void mpn::sqr(std::span<limb> r, std::span<const limb> a) {
+    ScratchArena::Frame frame;
+    sqr_n(r, a, frame.allocate<limb>(karatsuba_scratch_size(a.size())));
+}
+
+void mpn::redc(std::span<limb> r, std::span<limb> t, std::span<const limb> m, limb neg_m_inv) {
+    const size_t n = m.size();
+    // adding q*m with q = t[i] * -m^-1 clears limb i, after n steps t is divisible by BASE^n. the carry out of
+    // each step goes into limb i + n, and what overflows that is carried into the next step's limb
+    limb high_carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const limb q = t[i] * neg_m_inv;
+        const dlimb top = (dlimb)addmul_1(t.subspan(i, n), m, q) + t[i + n] + high_carry;
+        t[i + n] = (limb)top;
+        high_carry = (limb)(top >> BITS_IN_LIMB);
+    }
+    // t / BASE^n < 2m, one subtraction brings it below m
+    const std::span<const limb> high = t.subspan(n, n);
+    if (high_carry || cmp(high, m) >= 0) {
+        sub_n(r, high, m);
+    } else {
+        std::copy(high.begin(), high.end(), r.begin());
+    }
+}
+
+limb mpn::divrem_1(std::span<limb> q, std::span<const limb> a, limb d) {
+    BIGINT_STAT_SCOPE(DIVREM_1, a.size());
+    dlimb rem = 0;
+    for (size_t i = a.size(); i-- > 0;) { // one pass from MSD -> LSD carrying the running remainder
+        dlimb cur = rem << BITS_IN_LIMB | a[i];
+        q[i] = (limb)(cur / d);
+        rem = cur % d;
+    }
+    return (limb)rem;
+}
+
+void mpn::divrem_basecase(std::span<limb> q, std::span<limb> u, std::span<const limb> d) {
+    BIGINT_STAT_SCOPE(DIVREM_BASECASE, u.size());
+    const size_t n = d.size();
+    const dlimb base = (dlimb)1 << BITS_IN_LIMB;
+    for (size_t j = q.size(); j-- > 0;) {
+        // estimate quotient digit from the top two limbs of the current remainder and top limb of the divisor,
+        // since d is normalized the estimate is at most two too big
+        dlimb top = (dlimb)u[j + n] << BITS_IN_LIMB | u[j + n - 1];
+        dlimb qhat = top / d[n - 1];
+        dlimb rhat = top % d[n - 1];
+        while (qhat >= base || qhat * d[n - 2] > (rhat << BITS_IN_LIMB | u[j + n - 2])) {
+            --qhat;
+            rhat += d[n - 1];
+            if (rhat >= base) {
+                break;
+            }
+        }
+
+        // multiply and subtract qhat * d from the current window of u
+        const std::span<limb> window = u.subspan(j, n);
+        const limb underflow = submul_1(window, d, (limb)qhat);
+        const limb top_limb = u[j + n];
+        u[j + n] = top_limb - underflow;
+        if (top_limb < underflow) { // estimate was one too big (rare), add the divisor back
+            --qhat;
+            u[j + n] += add_n(window, window, d);
+        }
+        q[j] = (limb)qhat;
+    }
+}
+
+// pads d and u with low zero limbs until d fills n = j * 2^i limbs with j <= thresholds.burnikel_ziegler, so every
+// level of the recursion halves evenly down to schoolbook blocks, then divides u one 2n/n block at a time from the
+// top. the padding multiplies quotient and remainder's dividend alike and is dropped from the remainder after
+void mpn::divrem_bz(std::span<limb> q, std::span<limb> u, std::span<const limb> d) {
+    BIGINT_STAT_SCOPE(DIVREM_BZ, u.size());
+    const size_t s = d.size();
+    size_t m = 1;
+    while (m * thresholds.burnikel_ziegler <= s) {
+        m <<= 1;
+    }
+    const size_t n = (s + m - 1) / m * m;
+    const size_t pad = n - s;
+
+    // u*BASE^pad < d*BASE^pad * BASE^q.size(), so zero-extending it to t blocks of n keeps its top block below d
+    const size_t t = std::max<size_t>((q.size() + 2 * n - 1) / n, 2);
+    ScratchArena::Frame frame;
+    const std::span<limb> padded_d = frame.allocate<limb>(n);
+    const std::span<limb> padded_u = frame.allocate<limb>(t * n);
+    const std::span<limb> padded_q = frame.allocate<limb>((t - 1) * n);
+    std::fill(padded_d.begin(), padded_d.begin() + pad, 0);
+    std::copy(d.begin(), d.end(), padded_d.begin() + pad);
+    std::fill(padded_u.begin(), padded_u.end(), 0);
+    std::copy(u.begin(), u.end(), padded_u.begin() + pad);
+
+    // each block's remainder becomes the top half of the next block
+    for (size_t i = t - 1; i > 0; --i) {
+        bz_div_2n_1n(padded_q.subspan((i - 1) * n, n), padded_u.subspan((i - 1) * n, 2 * n), padded_d);
+    }
+    std::copy(padded_q.begin(), padded_q.begin() + q.size(), q.begin());
+    std::copy(padded_u.begin() + pad, padded_u.begin() + n, u.begin());
+}
+
+void mpn::divrem(std::span<limb> q, std::span<limb> u, std::span<const limb> d) {
+    if (d.size() < thresholds.burnikel_ziegler || q.size() < thresholds.burnikel_ziegler) {
+        divrem_basecase(q, u, d); // short divisor or short quotient, recursion overhead not worth it
+    } else {
+        divrem_bz(q, u, d);
+    }
+}
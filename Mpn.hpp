@@ -0,0 +1,332 @@
+#pragma once
+#include <span>
+#include <type_traits>
+#include "BigInt.hpp"
+
+/* ***************************************************
+ *             LOW-LEVEL LIMB KERNELS              *
+ ***************************************************  */
+
+// mpn functions work on non-owning little-endian spans of limbs (least significant limb first) and never allocate.
+// results are written to caller-provided spans, which may alias an input exactly but must not partially overlap one.
+namespace mpn {
+
+// portable kernels on pointer-and-length arrays. the span kernels below run these directly for short arrays and
+// in constant evaluation, longer arrays go through the kernel table picked for the running CPU
+namespace generic {
+
+constexpr int cmp(const limb* a, const limb* b, size_t n) {
+	for (size_t i = n; i-- > 0;) { // go from MSB -> LSB, first array with smaller limb is smaller
+		if (a[i] != b[i]) {
+			return a[i] < b[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+constexpr limb add_n(limb* r, const limb* a, const limb* b, size_t n) {
+	limb carry = 0;
+	for (size_t i = 0; i < n; ++i) {
+		dlimb true_add = (dlimb)a[i] + b[i] + carry;
+		r[i] = (limb)true_add;                     // gives result mod BASE
+		carry = (limb)(true_add >> BITS_IN_LIMB); // 1 if true_add > BASE - 1 else 0
+	}
+	return carry;
+}
+
+constexpr limb sub_n(limb* r, const limb* a, const limb* b, size_t n) {
+	limb underflow = 0;
+	for (size_t i = 0; i < n; ++i) {
+		dlimb true_sub = (dlimb)a[i] - b[i] - underflow;
+		r[i] = (limb)true_sub;                                    // gives result mod BASE
+		underflow = (limb)(true_sub >> (2 * BITS_IN_LIMB - 1)); // 1 if the subtraction wrapped around else 0
+	}
+	return underflow;
+}
+
+constexpr limb mul_1(limb* r, const limb* a, size_t n, limb b) {
+	limb overflow = 0;
+	for (size_t i = 0; i < n; ++i) {
+		dlimb true_mult = (dlimb)a[i] * b + overflow; // yes, (BASE-1)^2 + (BASE-1) < BASE^2
+		r[i] = (limb)true_mult;                      // gives result mod BASE
+		overflow = (limb)(true_mult >> BITS_IN_LIMB);
+	}
+	return overflow;
+}
+
+constexpr limb addmul_1(limb* r, const limb* a, size_t n, limb b) {
+	limb overflow = 0;
+	for (size_t i = 0; i < n; ++i) {
+		dlimb true_mult = (dlimb)a[i] * b + r[i] + overflow; // (BASE-1)^2 + 2(BASE-1) == BASE^2 - 1, still fits
+		r[i] = (limb)true_mult;
+		overflow = (limb)(true_mult >> BITS_IN_LIMB);
+	}
+	return overflow;
+}
+
+constexpr limb submul_1(limb* r, const limb* a, size_t n, limb b) {
+	limb overflow = 0;
+	for (size_t i = 0; i < n; ++i) {
+		dlimb true_mult = (dlimb)a[i] * b + overflow;
+		limb low = (limb)true_mult;
+		overflow = (limb)(true_mult >> BITS_IN_LIMB) + (r[i] < low);
+		r[i] -= low;
+	}
+	return overflow;
+}
+
+} // namespace generic
+
+// the kernels the span functions dispatch to. it starts out holding the generic kernels and is switched to the
+// fastest ones the CPU supports during static initialization (see MpnDispatch.cpp)
+struct kernel_table {
+	int (*cmp)(const limb* a, const limb* b, size_t n);
+	limb (*add_n)(limb* r, const limb* a, const limb* b, size_t n);
+	limb (*sub_n)(limb* r, const limb* a, const limb* b, size_t n);
+	limb (*mul_1)(limb* r, const limb* a, size_t n, limb b);
+	limb (*addmul_1)(limb* r, const limb* a, size_t n, limb b);
+	limb (*submul_1)(limb* r, const limb* a, size_t n, limb b);
+};
+extern kernel_table kernels;
+
+// the crossover points the algorithms below pick their tier with, set through BigInt::set_thresholds
+extern Thresholds thresholds;
+
+// instruction set extensions the dispatched kernels can use
+struct cpu_features {
+	bool bmi2_adx = false; // mulx, adcx and adox
+	bool avx2 = false;
+	bool avx512 = false;   // AVX-512 foundation
+};
+
+// features of the CPU we are running on, all false off x86-64 or on compilers without the needed builtins
+cpu_features detect_cpu_features();
+
+// fills the kernel table with the fastest kernels the given features allow. this runs once at startup with
+// detect_cpu_features(), calling it again (e.g. to pin a slower tier in a benchmark) must not race with arithmetic
+void select_kernels(const cpu_features& features);
+
+// compares two equal-length limb arrays, returns -1, 0 or 1 if a is less than, equal to or greater than b
+constexpr int cmp(std::span<const limb> a, std::span<const limb> b) {
+	if (!std::is_constant_evaluated() && a.size() >= DISPATCH_CUTOFF) {
+		return kernels.cmp(a.data(), b.data(), a.size());
+	}
+	return generic::cmp(a.data(), b.data(), a.size());
+}
+
+// number of limbs left once leading zero limbs are dropped
+constexpr size_t normalized_size(std::span<const limb> a) {
+	size_t n = a.size();
+	while (n > 0 && a[n - 1] == 0) {
+		--n;
+	}
+	return n;
+}
+
+// r = a + b for equal-length a and b, returns the carry out
+constexpr limb add_n(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+	if (!std::is_constant_evaluated() && a.size() >= DISPATCH_CUTOFF) {
+		return kernels.add_n(r.data(), a.data(), b.data(), a.size());
+	}
+	return generic::add_n(r.data(), a.data(), b.data(), a.size());
+}
+
+// r = a + b where a.size() >= b.size() and r.size() == a.size(), returns the carry out
+constexpr limb add(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+	limb carry = add_n(r, a.first(b.size()), b);
+	for (size_t i = b.size(); i < a.size(); ++i) {
+		r[i] = a[i] + carry;
+		carry = r[i] < carry;
+	}
+	return carry;
+}
+
+// r = a + b for a single limb b, returns the carry out
+constexpr limb add_1(std::span<limb> r, std::span<const limb> a, limb b) {
+	limb carry = b;
+	for (size_t i = 0; i < a.size(); ++i) {
+		r[i] = a[i] + carry;
+		carry = r[i] < carry;
+	}
+	return carry;
+}
+
+// r = a - b for equal-length a and b, returns the borrow out
+constexpr limb sub_n(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+	if (!std::is_constant_evaluated() && a.size() >= DISPATCH_CUTOFF) {
+		return kernels.sub_n(r.data(), a.data(), b.data(), a.size());
+	}
+	return generic::sub_n(r.data(), a.data(), b.data(), a.size());
+}
+
+// r = a - b where a.size() >= b.size() and r.size() == a.size(), returns the borrow out
+constexpr limb sub(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+	limb underflow = sub_n(r, a.first(b.size()), b);
+	for (size_t i = b.size(); i < a.size(); ++i) {
+		const limb digit = a[i]; // read before writing, r may alias a
+		r[i] = digit - underflow;
+		underflow = digit < underflow;
+	}
+	return underflow;
+}
+
+// r = a - b for a single limb b, returns the borrow out
+constexpr limb sub_1(std::span<limb> r, std::span<const limb> a, limb b) {
+	limb underflow = b;
+	for (size_t i = 0; i < a.size(); ++i) {
+		const limb digit = a[i]; // read before writing, r may alias a
+		r[i] = digit - underflow;
+		underflow = digit < underflow;
+	}
+	return underflow;
+}
+
+// r = |a - b| where a.size() >= b.size() and r.size() == a.size(), returns true if a < b
+constexpr bool sub_abs(std::span<limb> r, std::span<const limb> a, std::span<const limb> b) {
+	const size_t n = b.size();
+	const bool less = normalized_size(a.subspan(n)) == 0 && cmp(a.first(n), b) < 0;
+	if (less) {
+		sub_n(r.first(n), b, a.first(n));
+		std::fill(r.begin() + n, r.end(), 0); // a's limbs above b's are all zero here
+	} else {
+		sub(r, a, b);
+	}
+	return less;
+}
+
+// r = a * b for a single limb b, returns the high limb of the product
+constexpr limb mul_1(std::span<limb> r, std::span<const limb> a, limb b) {
+	if (!std::is_constant_evaluated() && a.size() >= DISPATCH_CUTOFF) {
+		return kernels.mul_1(r.data(), a.data(), a.size(), b);
+	}
+	return generic::mul_1(r.data(), a.data(), a.size(), b);
+}
+
+// r += a * b over a.size() limbs for a single limb b, returns the limb carried out
+constexpr limb addmul_1(std::span<limb> r, std::span<const limb> a, limb b) {
+	if (!std::is_constant_evaluated() && a.size() >= DISPATCH_CUTOFF) {
+		return kernels.addmul_1(r.data(), a.data(), a.size(), b);
+	}
+	return generic::addmul_1(r.data(), a.data(), a.size(), b);
+}
+
+// r -= a * b over a.size() limbs for a single limb b, returns the limb borrowed out
+constexpr limb submul_1(std::span<limb> r, std::span<const limb> a, limb b) {
+	if (!std::is_constant_evaluated() && a.size() >= DISPATCH_CUTOFF) {
+		return kernels.submul_1(r.data(), a.data(), a.size(), b);
+	}
+	return generic::submul_1(r.data(), a.data(), a.size(), b);
+}
+
+// returns d^-1 mod BASE for odd d
+constexpr limb binvert_1(limb d) {
+	limb inverse = d; // correct to 3 bits since d * d == 1 mod 8, each newton step doubles that
+	for (int i = 0; i < 5; ++i) {
+		inverse *= 2 - d * inverse;
+	}
+	return inverse;
+}
+
+// q = a / d for odd d that divides a exactly, multiplies by d^-1 mod BASE instead of dividing. q may alias a
+constexpr void divexact_1(std::span<limb> q, std::span<const limb> a, limb d) {
+	const limb inverse = binvert_1(d);
+	limb underflow = 0;
+	for (size_t i = 0; i < a.size(); ++i) {
+		const limb digit = a[i];
+		const limb quotient_digit = (limb)(digit - underflow) * inverse;
+		q[i] = quotient_digit;
+		underflow = (limb)(((dlimb)quotient_digit * d) >> BITS_IN_LIMB) + (digit < underflow);
+	}
+}
+
+// r = a << bits for bits < BITS_IN_LIMB, r.size() == a.size(), returns the bits shifted out of the top limb
+constexpr limb lshift(std::span<limb> r, std::span<const limb> a, unsigned bits) {
+	if (bits == 0) {
+		std::copy(a.begin(), a.end(), r.begin());
+		return 0;
+	}
+	const size_t n = a.size();
+	const limb out = a[n - 1] >> (BITS_IN_LIMB - bits);
+	for (size_t i = n - 1; i > 0; --i) { // MSB -> LSB so r may alias a
+		r[i] = (a[i] << bits) | (a[i - 1] >> (BITS_IN_LIMB - bits));
+	}
+	r[0] = a[0] << bits;
+	return out;
+}
+
+// r = a >> bits for bits < BITS_IN_LIMB, r.size() == a.size(), returns the bits shifted out of the bottom limb (in the high end of the limb)
+constexpr limb rshift(std::span<limb> r, std::span<const limb> a, unsigned bits) {
+	if (bits == 0) {
+		std::copy(a.begin(), a.end(), r.begin());
+		return 0;
+	}
+	const size_t n = a.size();
+	const limb out = a[0] << (BITS_IN_LIMB - bits);
+	for (size_t i = 0; i + 1 < n; ++i) { // LSB -> MSB so r may alias a
+		r[i] = (a[i] >> bits) | (a[i + 1] << (BITS_IN_LIMB - bits));
+	}
+	r[n - 1] = a[n - 1] >> bits;
+	return out;
+}
+
+// r = a * b using long multiplication (gradeschool multiplication), r.size() == a.size() + b.size(), complexity O(n*m)
+void mul_basecase(std::span<limb> r, std::span<const limb> a, std::span<const limb> b);
+
+// r = a * b for equal-length a and b using karatsuba multiplication, complexity O(n^(log2(3))).
+// scratch must hold karatsuba_scratch_size(a.size()) limbs
+void mul_karatsuba(std::span<limb> r, std::span<const limb> a, std::span<const limb> b, std::span<limb> scratch);
+size_t karatsuba_scratch_size(size_t n);
+
+// r = a^2 with r.size() == 2 * a.size(), the squaring counterparts of mul_basecase and mul_karatsuba. a square only
+// needs the n(n-1)/2 cross products a[i]*a[j] with i < j, doubled, plus the diagonal, about half the work of a product
+void sqr_basecase(std::span<limb> r, std::span<const limb> a);
+void sqr_karatsuba(std::span<limb> r, std::span<const limb> a, std::span<limb> scratch);
+
+// r = a * b for equal-length a and b using toom-cook 3-way and 4-way splitting, complexity O(n^(log3(5))) and
+// O(n^(log4(7))). the operands must be long enough for every part to be non-empty (at least 5 and 7 limbs).
+// passing the same span as a and b squares it, evaluating it once and squaring the point values
+void mul_toom3(std::span<limb> r, std::span<const limb> a, std::span<const limb> b);
+void mul_toom4(std::span<limb> r, std::span<const limb> a, std::span<const limb> b);
+
+// r = a * b using a number theoretic transform modulo three primes, complexity O(n log n).
+// r.size() == a.size() + b.size() must not exceed NTT_MAX_LENGTH. passing the same span as a and b squares it
+// with one forward transform per prime instead of two
+void mul_ntt(std::span<limb> r, std::span<const limb> a, std::span<const limb> b);
+
+// executor that multiplications above thresholds.parallel split their sub-products over, nullptr (the default) keeps
+// everything on the calling thread. must not be changed while a multiplication is running
+void set_executor(std::shared_ptr<Executor> executor);
+Executor* get_executor();
+
+// r = a * b with the fastest algorithm for the operand sizes, r.size() == a.size() + b.size(). goes to sqr when a
+// and b are the same span
+void mul(std::span<limb> r, std::span<const limb> a, std::span<const limb> b);
+
+// r = a^2 with the fastest squaring algorithm for the size, r.size() == 2 * a.size()
+void sqr(std::span<limb> r, std::span<const limb> a);
+
+// mul and sqr for equal-length operands with caller-provided scratch of karatsuba_scratch_size(a.size()) limbs,
+// which keeps them from allocating below the toom-cook cutoffs
+void mul_n(std::span<limb> r, std::span<const limb> a, std::span<const limb> b, std::span<limb> scratch);
+void sqr_n(std::span<limb> r, std::span<const limb> a, std::span<limb> scratch);
+
+// montgomery reduction: r = t * BASE^-n mod m for n = m.size(), odd m and t < m * BASE^n with t.size() == 2n.
+// neg_m_inv is -m^-1 mod BASE (see binvert_1), t is overwritten and r.size() == n
+void redc(std::span<limb> r, std::span<limb> t, std::span<const limb> m, limb neg_m_inv);
+
+// q = a / d for a single limb d, returns the remainder. q.size() == a.size()
+limb divrem_1(std::span<limb> q, std::span<const limb> a, limb d);
+
+// divides u by d using Knuth's algorithm D, complexity O(n*m). d must be normalized (top bit set) with at least two limbs
+// and the top d.size() limbs of u must be less than d. q.size() == u.size() - d.size() receives the quotient and the
+// remainder is left in u.first(d.size())
+void divrem_basecase(std::span<limb> q, std::span<limb> u, std::span<const limb> d);
+
+// divrem_basecase's division with Burnikel-Ziegler recursive division, complexity O(M(n) log n) where M(n) is the cost
+// of an n-limb multiplication. temporaries come from the thread's ScratchArena
+void divrem_bz(std::span<limb> q, std::span<limb> u, std::span<const limb> d);
+
+// divrem_basecase's division with the fastest algorithm for the sizes
+void divrem(std::span<limb> q, std::span<limb> u, std::span<const limb> d);
+
+} // namespace mpn
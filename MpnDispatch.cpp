@@ -0,0 +1,425 @@
+#include "../include/Mpn.hpp"
+
+// the x86 kernels are compiled for their instruction sets with target attributes, so one binary built for the
+// baseline architecture carries all of them and picks at runtime
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MPN_X86 1
+#include <immintrin.h>
+#define MPN_TARGET(features) __attribute__((target(features)))
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // some GCC 12 releases warn from inside the AVX-512 headers
+#endif
+#else
+#define MPN_X86 0
+#endif
+
+mpn::kernel_table mpn::kernels = {
+    generic::cmp, generic::add_n, generic::sub_n, generic::mul_1, generic::addmul_1, generic::submul_1,
+};
+
+#if MPN_X86
+namespace {
+
+/* ***************************************************
+ *             CARRY-CHAIN (64-BIT LIMB)            *
+ ***************************************************  */
+
+#if BIGINT_LIMB64
+// adc/sbb are part of baseline x86-64, the intrinsics keep the carry in the flags instead of a register
+limb add_n_adc(limb *r, const limb *a, const limb *b, size_t n) {
+    unsigned char carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        carry = _addcarry_u64(carry, a[i], b[i], &r[i]);
+    }
+    return carry;
+}
+
+limb sub_n_sbb(limb *r, const limb *a, const limb *b, size_t n) {
+    unsigned char underflow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        underflow = _subborrow_u64(underflow, a[i], b[i], &r[i]);
+    }
+    return underflow;
+}
+
+// mulx leaves the flags alone, so the high half of each product can ride into the next limb on the adcx carry
+// chain (CF) while addmul_1 accumulates the row on a second, independent adox chain (OF). compilers do not keep
+// two carry chains in the flags on their own, hence the inline assembly. loop control uses lea and jrcxz, which
+// leave both flags intact
+MPN_TARGET("bmi2,adx")
+limb mul_1_mulx(limb *r, const limb *a, size_t n, limb b) {
+    limb high = 0, lo, hi;
+    if (n == 0) {
+        return high;
+    }
+    __asm__ volatile(
+        "xor %k[lo], %k[lo]\n\t" // clears CF and OF
+        "1:\n\t"
+        "mulx (%[a]), %[lo], %[hi]\n\t"
+        "adcx %[high], %[lo]\n\t"
+        "mov %[lo], (%[r])\n\t"
+        "mov %[hi], %[high]\n\t"
+        "lea 8(%[a]), %[a]\n\t"
+        "lea 8(%[r]), %[r]\n\t"
+        "lea -1(%[n]), %[n]\n\t"
+        "jrcxz 2f\n\t"
+        "jmp 1b\n\t"
+        "2:\n\t"
+        "mov $0, %k[lo]\n\t"
+        "adcx %[lo], %[high]\n\t"
+        : [r] "+r"(r), [a] "+r"(a), [n] "+c"(n), [high] "+r"(high), [lo] "=&r"(lo), [hi] "=&r"(hi)
+        : "d"(b)
+        : "cc", "memory");
+    return high;
+}
+
+MPN_TARGET("bmi2,adx")
+limb addmul_1_mulx(limb *r, const limb *a, size_t n, limb b) {
+    limb high = 0, lo, hi;
+    if (n == 0) {
+        return high;
+    }
+    __asm__ volatile(
+        "xor %k[lo], %k[lo]\n\t"
+        "1:\n\t"
+        "mulx (%[a]), %[lo], %[hi]\n\t"
+        "adcx %[high], %[lo]\n\t"
+        "adox (%[r]), %[lo]\n\t"
+        "mov %[lo], (%[r])\n\t"
+        "mov %[hi], %[high]\n\t"
+        "lea 8(%[a]), %[a]\n\t"
+        "lea 8(%[r]), %[r]\n\t"
+        "lea -1(%[n]), %[n]\n\t"
+        "jrcxz 2f\n\t"
+        "jmp 1b\n\t"
+        "2:\n\t"
+        "mov $0, %k[lo]\n\t"
+        "adcx %[lo], %[high]\n\t" // cannot wrap, r + a * b fits in n + 1 limbs
+        "adox %[lo], %[high]\n\t"
+        : [r] "+r"(r), [a] "+r"(a), [n] "+c"(n), [high] "+r"(high), [lo] "=&r"(lo), [hi] "=&r"(hi)
+        : "d"(b)
+        : "cc", "memory");
+    return high;
+}
+#endif
+
+/* ***************************************************
+ *                   AVX2 KERNELS                   *
+ ***************************************************  */
+
+// lane helpers for limb-sized lanes, the unused branch of each if constexpr is never executed
+const size_t AVX2_LANES = 32 / sizeof(limb);
+
+MPN_TARGET("avx2") inline __m256i load256(const limb *p) { return _mm256_loadu_si256((const __m256i *)p); }
+MPN_TARGET("avx2") inline void store256(limb *p, __m256i v) { _mm256_storeu_si256((__m256i *)p, v); }
+
+MPN_TARGET("avx2") inline __m256i add_lanes(__m256i a, __m256i b) {
+    if constexpr (sizeof(limb) == 4) return _mm256_add_epi32(a, b); else return _mm256_add_epi64(a, b);
+}
+MPN_TARGET("avx2") inline __m256i sub_lanes(__m256i a, __m256i b) {
+    if constexpr (sizeof(limb) == 4) return _mm256_sub_epi32(a, b); else return _mm256_sub_epi64(a, b);
+}
+MPN_TARGET("avx2") inline __m256i set_lanes(limb x) {
+    if constexpr (sizeof(limb) == 4) return _mm256_set1_epi32((int)x); else return _mm256_set1_epi64x((long long)x);
+}
+
+// one bit per lane, set where a == b
+MPN_TARGET("avx2") inline uint equal_mask(__m256i a, __m256i b) {
+    if constexpr (sizeof(limb) == 4) return (uint)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+    else return (uint)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b)));
+}
+
+// one bit per lane, set where a < b as unsigned numbers (flipping the sign bits turns the signed compare unsigned)
+MPN_TARGET("avx2") inline uint less_mask(__m256i a, __m256i b) {
+    const __m256i sign = set_lanes((limb)1 << (BITS_IN_LIMB - 1));
+    a = _mm256_xor_si256(a, sign);
+    b = _mm256_xor_si256(b, sign);
+    if constexpr (sizeof(limb) == 4) return (uint)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)));
+    else return (uint)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(b, a)));
+}
+
+// all-ones in every lane whose bit is set in mask
+MPN_TARGET("avx2") inline __m256i lanes_from_mask(uint mask) {
+    const __m256i bits = sizeof(limb) == 4 ? _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) : _mm256_setr_epi64x(1, 2, 4, 8);
+    const __m256i selected = _mm256_and_si256(set_lanes(mask), bits);
+    if constexpr (sizeof(limb) == 4) return _mm256_cmpeq_epi32(selected, bits); else return _mm256_cmpeq_epi64(selected, bits);
+}
+
+// carry-select: each lane adds without carries, then one lane bit per limb says whether it generates a carry
+// or propagates an incoming one. adding generate + (generate | propagate) + carry as plain integers ripples the
+// carries through all lanes at once, the lanes receiving one are (sum ^ propagate) and the carry out is the bit
+// above the top lane
+inline uint carry_in_lanes(uint generate, uint propagate, uint &carry, size_t lanes) {
+    const uint ripple = generate + (generate | propagate) + carry;
+    carry = ripple >> lanes;
+    return ripple ^ propagate;
+}
+
+MPN_TARGET("avx2")
+int cmp_avx2(const limb *a, const limb *b, size_t n) {
+    size_t i = n;
+    while (i >= AVX2_LANES) {
+        i -= AVX2_LANES;
+        const uint equal = equal_mask(load256(a + i), load256(b + i));
+        if (equal != (1u << AVX2_LANES) - 1) {
+            const size_t j = i + (BITS_IN_UINT - 1 - std::countl_zero(~equal & ((1u << AVX2_LANES) - 1)));
+            return a[j] < b[j] ? -1 : 1;
+        }
+    }
+    return mpn::generic::cmp(a, b, i);
+}
+
+MPN_TARGET("avx2")
+limb add_n_avx2(limb *r, const limb *a, const limb *b, size_t n) {
+    const __m256i ones = _mm256_set1_epi32(-1);
+    uint carry = 0;
+    size_t i = 0;
+    for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+        const __m256i va = load256(a + i);
+        __m256i sum = add_lanes(va, load256(b + i));
+        const uint carry_in = carry_in_lanes(less_mask(sum, va), equal_mask(sum, ones), carry, AVX2_LANES);
+        sum = sub_lanes(sum, lanes_from_mask(carry_in)); // subtracting all-ones adds the incoming carry
+        store256(r + i, sum);
+    }
+    const limb tail_carry = mpn::generic::add_n(r + i, a + i, b + i, n - i);
+    return tail_carry + mpn::add_1(std::span<limb>(r + i, n - i), std::span<const limb>(r + i, n - i), carry);
+}
+
+MPN_TARGET("avx2")
+limb sub_n_avx2(limb *r, const limb *a, const limb *b, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint underflow = 0;
+    size_t i = 0;
+    for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+        const __m256i va = load256(a + i), vb = load256(b + i);
+        __m256i diff = sub_lanes(va, vb);
+        // a lane generates a borrow when a < b and passes an incoming one on when its difference is zero
+        const uint borrow_in = carry_in_lanes(less_mask(va, vb), equal_mask(diff, zero), underflow, AVX2_LANES);
+        diff = add_lanes(diff, lanes_from_mask(borrow_in)); // adding all-ones subtracts the incoming borrow
+        store256(r + i, diff);
+    }
+    const limb tail_underflow = mpn::generic::sub_n(r + i, a + i, b + i, n - i);
+    return tail_underflow + mpn::sub_1(std::span<limb>(r + i, n - i), std::span<const limb>(r + i, n - i), underflow);
+}
+
+#if !BIGINT_LIMB64
+// r = a * b (or r += a * b when accumulating) for 32-bit limbs, one 64-bit multiply per pair of lanes. the old
+// r limb is added to each product in its 64-bit lane, (BASE-1)^2 + (BASE-1) still fits, so lane i of the row is
+// lo(a[i] * b + r[i]) + hi(a[i-1] * b + r[i-1]) where lane 0 takes the high limb carried over from the previous
+// block. only the carries between lanes then need the carry-select step
+template <bool accumulate>
+MPN_TARGET("avx2")
+limb mul_row_avx2(limb *r, const limb *a, size_t n, limb b) {
+    const __m256i vb = _mm256_set1_epi64x(b), ones = _mm256_set1_epi32(-1);
+    const __m256i low_halves = _mm256_set1_epi64x(0xFFFFFFFF);
+    const __m256i rotate = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+    limb high = 0;
+    size_t i = 0;
+    for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+        const __m256i va = load256(a + i);
+        __m256i even = _mm256_mul_epu32(va, vb);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(va, 32), vb);
+        if constexpr (accumulate) {
+            const __m256i vr = load256(r + i);
+            even = _mm256_add_epi64(even, _mm256_and_si256(vr, low_halves));
+            odd = _mm256_add_epi64(odd, _mm256_srli_epi64(vr, 32));
+        }
+        const __m256i lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        __m256i hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+        const limb top = (limb)_mm256_extract_epi32(hi, 7);
+        hi = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(hi, rotate), _mm256_set1_epi32((int)high), 0x01);
+
+        const __m256i row = add_lanes(lo, hi);
+        uint carry = 0;
+        const uint carry_in = carry_in_lanes(less_mask(row, lo), equal_mask(row, ones), carry, AVX2_LANES);
+        store256(r + i, sub_lanes(row, lanes_from_mask(carry_in)));
+        high = top + carry; // top <= BASE - 2, so this fits
+    }
+    for (; i < n; ++i) {
+        dlimb true_mult = (dlimb)a[i] * b + (accumulate ? r[i] : 0) + high;
+        r[i] = (limb)true_mult;
+        high = (limb)(true_mult >> BITS_IN_LIMB);
+    }
+    return high;
+}
+
+limb mul_1_avx2(limb *r, const limb *a, size_t n, limb b) { return mul_row_avx2<false>(r, a, n, b); }
+limb addmul_1_avx2(limb *r, const limb *a, size_t n, limb b) { return mul_row_avx2<true>(r, a, n, b); }
+#endif
+
+/* ***************************************************
+ *                  AVX-512 KERNELS                 *
+ ***************************************************  */
+
+// AVX-512 compares straight into mask registers and can add or subtract under a mask, so the carry-select step
+// needs no movemask or mask expansion
+const size_t AVX512_LANES = 64 / sizeof(limb);
+
+MPN_TARGET("avx512f") inline __m512i load512(const limb *p) { return _mm512_loadu_si512((const void *)p); }
+MPN_TARGET("avx512f") inline void store512(limb *p, __m512i v) { _mm512_storeu_si512((void *)p, v); }
+
+MPN_TARGET("avx512f") inline __m512i add_lanes(__m512i a, __m512i b) {
+    if constexpr (sizeof(limb) == 4) return _mm512_add_epi32(a, b); else return _mm512_add_epi64(a, b);
+}
+MPN_TARGET("avx512f") inline __m512i sub_lanes(__m512i a, __m512i b) {
+    if constexpr (sizeof(limb) == 4) return _mm512_sub_epi32(a, b); else return _mm512_sub_epi64(a, b);
+}
+MPN_TARGET("avx512f") inline uint equal_mask(__m512i a, __m512i b) {
+    if constexpr (sizeof(limb) == 4) return _mm512_cmpeq_epi32_mask(a, b); else return _mm512_cmpeq_epi64_mask(a, b);
+}
+MPN_TARGET("avx512f") inline uint less_mask(__m512i a, __m512i b) {
+    if constexpr (sizeof(limb) == 4) return _mm512_cmplt_epu32_mask(a, b); else return _mm512_cmplt_epu64_mask(a, b);
+}
+
+// x - 1 in the lanes set in mask (subtracting all-ones from x adds 1)
+MPN_TARGET("avx512f") inline __m512i add_one_lanes(__m512i x, uint mask) {
+    const __m512i ones = _mm512_set1_epi32(-1);
+    if constexpr (sizeof(limb) == 4) return _mm512_mask_sub_epi32(x, (__mmask16)mask, x, ones);
+    else return _mm512_mask_sub_epi64(x, (__mmask8)mask, x, ones);
+}
+MPN_TARGET("avx512f") inline __m512i sub_one_lanes(__m512i x, uint mask) {
+    const __m512i ones = _mm512_set1_epi32(-1);
+    if constexpr (sizeof(limb) == 4) return _mm512_mask_add_epi32(x, (__mmask16)mask, x, ones);
+    else return _mm512_mask_add_epi64(x, (__mmask8)mask, x, ones);
+}
+
+MPN_TARGET("avx512f")
+int cmp_avx512(const limb *a, const limb *b, size_t n) {
+    size_t i = n;
+    while (i >= AVX512_LANES) {
+        i -= AVX512_LANES;
+        const uint differ = ~equal_mask(load512(a + i), load512(b + i)) & ((1u << AVX512_LANES) - 1);
+        if (differ) {
+            const size_t j = i + (BITS_IN_UINT - 1 - std::countl_zero(differ));
+            return a[j] < b[j] ? -1 : 1;
+        }
+    }
+    return mpn::generic::cmp(a, b, i);
+}
+
+MPN_TARGET("avx512f")
+limb add_n_avx512(limb *r, const limb *a, const limb *b, size_t n) {
+    const __m512i ones = _mm512_set1_epi32(-1);
+    uint carry = 0;
+    size_t i = 0;
+    for (; i + AVX512_LANES <= n; i += AVX512_LANES) {
+        const __m512i va = load512(a + i);
+        const __m512i sum = add_lanes(va, load512(b + i));
+        const uint carry_in = carry_in_lanes(less_mask(sum, va), equal_mask(sum, ones), carry, AVX512_LANES);
+        store512(r + i, add_one_lanes(sum, carry_in));
+    }
+    const limb tail_carry = mpn::generic::add_n(r + i, a + i, b + i, n - i);
+    return tail_carry + mpn::add_1(std::span<limb>(r + i, n - i), std::span<const limb>(r + i, n - i), carry);
+}
+
+MPN_TARGET("avx512f")
+limb sub_n_avx512(limb *r, const limb *a, const limb *b, size_t n) {
+    const __m512i zero = _mm512_setzero_si512();
+    uint underflow = 0;
+    size_t i = 0;
+    for (; i + AVX512_LANES <= n; i += AVX512_LANES) {
+        const __m512i va = load512(a + i), vb = load512(b + i);
+        const __m512i diff = sub_lanes(va, vb);
+        const uint borrow_in = carry_in_lanes(less_mask(va, vb), equal_mask(diff, zero), underflow, AVX512_LANES);
+        store512(r + i, sub_one_lanes(diff, borrow_in));
+    }
+    const limb tail_underflow = mpn::generic::sub_n(r + i, a + i, b + i, n - i);
+    return tail_underflow + mpn::sub_1(std::span<limb>(r + i, n - i), std::span<const limb>(r + i, n - i), underflow);
+}
+
+#if !BIGINT_LIMB64
+// same scheme as mul_row_avx2
+template <bool accumulate>
+MPN_TARGET("avx512f")
+limb mul_row_avx512(limb *r, const limb *a, size_t n, limb b) {
+    const __m512i vb = _mm512_set1_epi64((long long)b), ones = _mm512_set1_epi32(-1);
+    const __m512i low_halves = _mm512_set1_epi64(0xFFFFFFFF);
+    limb high = 0;
+    size_t i = 0;
+    for (; i + AVX512_LANES <= n; i += AVX512_LANES) {
+        const __m512i va = load512(a + i);
+        __m512i even = _mm512_mul_epu32(va, vb);
+        __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(va, 32), vb);
+        if constexpr (accumulate) {
+            const __m512i vr = load512(r + i);
+            even = _mm512_add_epi64(even, _mm512_and_si512(vr, low_halves));
+            odd = _mm512_add_epi64(odd, _mm512_srli_epi64(vr, 32));
+        }
+        const __m512i lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+        __m512i hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+        const limb top = (limb)_mm_extract_epi32(_mm512_extracti32x4_epi32(hi, 3), 3);
+        hi = _mm512_alignr_epi32(hi, _mm512_set1_epi32((int)high), 15); // shift up one lane, high enters at lane 0
+
+        const __m512i row = add_lanes(lo, hi);
+        uint carry = 0;
+        const uint carry_in = carry_in_lanes(less_mask(row, lo), equal_mask(row, ones), carry, AVX512_LANES);
+        store512(r + i, add_one_lanes(row, carry_in));
+        high = top + carry;
+    }
+    for (; i < n; ++i) {
+        dlimb true_mult = (dlimb)a[i] * b + (accumulate ? r[i] : 0) + high;
+        r[i] = (limb)true_mult;
+        high = (limb)(true_mult >> BITS_IN_LIMB);
+    }
+    return high;
+}
+
+limb mul_1_avx512(limb *r, const limb *a, size_t n, limb b) { return mul_row_avx512<false>(r, a, n, b); }
+limb addmul_1_avx512(limb *r, const limb *a, size_t n, limb b) { return mul_row_avx512<true>(r, a, n, b); }
+#endif
+
+} // namespace
+#endif
+
+/* ***************************************************
+ *                 KERNEL SELECTION                 *
+ ***************************************************  */
+
+mpn::cpu_features mpn::detect_cpu_features() {
+    cpu_features features;
+#if MPN_X86
+    __builtin_cpu_init();
+    features.bmi2_adx = __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx");
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.avx512 = __builtin_cpu_supports("avx512f");
+#endif
+    return features;
+}
+
+void mpn::select_kernels(const cpu_features &features) {
+    kernel_table table = { generic::cmp, generic::add_n, generic::sub_n, generic::mul_1, generic::addmul_1, generic::submul_1 };
+#if MPN_X86
+#if BIGINT_LIMB64
+    table.add_n = add_n_adc;
+    table.sub_n = sub_n_sbb;
+    if (features.bmi2_adx) {
+        table.mul_1 = mul_1_mulx;
+        table.addmul_1 = addmul_1_mulx;
+    }
+#endif
+    if (features.avx2) {
+        table.cmp = cmp_avx2;
+        table.add_n = add_n_avx2;
+        table.sub_n = sub_n_avx2;
+#if !BIGINT_LIMB64
+        table.mul_1 = mul_1_avx2;
+        table.addmul_1 = addmul_1_avx2;
+#endif
+    }
+    if (features.avx512) {
+        table.cmp = cmp_avx512;
+        table.add_n = add_n_avx512;
+        table.sub_n = sub_n_avx512;
+#if !BIGINT_LIMB64
+        table.mul_1 = mul_1_avx512;
+        table.addmul_1 = addmul_1_avx512;
+#endif
+    }
+#endif
+    kernels = table;
+}
+
+namespace {
+// runs during static initialization, until then (and off x86) the table holds the generic kernels
+const bool kernels_selected = (mpn::select_kernels(mpn::detect_cpu_features()), true);
+}
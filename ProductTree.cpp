@@ -0,0 +1,73 @@
+#include "../include/ProductTree.hpp"
+
+/* ***************************************************
+ *              PRODUCT TREE METHODS                *
+ ***************************************************  */
+
+ProductTree::ProductTree(std::span<const BigInt> leaves) : leaf_values(leaves.begin(), leaves.end()) {
+    build(0, leaf_values.size());
+}
+
+// adds the nodes of leaves [begin, end) in preorder
+void ProductTree::build(size_t begin, size_t end) {
+    if (end - begin < 2) {
+        return;
+    }
+    const size_t index = nodes.size();
+    const size_t split = begin + BigInt::product_split(std::span<const BigInt>(leaf_values).subspan(begin, end - begin));
+    nodes.push_back(Node{ BigInt(), split, 0 });
+    build(begin, split);
+    nodes[index].right = nodes.size();
+    build(split, end);
+    nodes[index].value = value(begin, split, index + 1) * value(split, end, nodes[index].right);
+}
+
+// the product of leaves [begin, end), node being their node if there is more than one
+const BigInt &ProductTree::value(size_t begin, size_t end, size_t node) const {
+    return end - begin == 1 ? leaf_values[begin] : nodes[node].value;
+}
+
+size_t ProductTree::size() const {
+    return leaf_values.size();
+}
+
+const std::vector<BigInt> &ProductTree::leaves() const {
+    return leaf_values;
+}
+
+const BigInt &ProductTree::product() const {
+    static const BigInt one(1);
+    return leaf_values.empty() ? one : value(0, leaf_values.size(), 0);
+}
+
+// x is already reduced modulo the product of leaves [begin, end): reduces it modulo each half and goes on down
+void ProductTree::descend(const BigInt &x, size_t begin, size_t end, size_t node, std::vector<BigInt> &out) const {
+    if (end - begin == 1) {
+        out[begin] = x;
+        return;
+    }
+    const Node &n = nodes[node];
+    const BigInt &left = value(begin, n.split, node + 1);
+    const BigInt &right = value(n.split, end, n.right);
+    descend(x < left ? x : x % left, begin, n.split, node + 1, out);
+    descend(x < right ? x : x % right, n.split, end, n.right, out);
+}
+
+// reduces x modulo the root, then each node's remainder modulo its two halves, down to the leaves
+std::vector<BigInt> ProductTree::remainders(const BigInt &x) const {
+    if (leaf_values.empty()) {
+        return {};
+    }
+    for (const BigInt &leaf : leaf_values) {
+        if (leaf <= 0) {
+            throw std::domain_error("ProductTree: remainders need positive leaves");
+        }
+    }
+    BigInt top = x % product();
+    if (top < 0) {
+        top += product();
+    }
+    std::vector<BigInt> out(leaf_values.size());
+    descend(top, 0, leaf_values.size(), 0, out);
+    return out;
+}
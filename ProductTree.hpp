@@ -0,0 +1,38 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "BigInt.hpp"
+
+// a product tree over a list of numbers: the leaves hold them, every node above the product of its two subtrees,
+// the root their product. each run of leaves is split where the limbs on both sides come closest to half its
+// total, the same split BigInt::product uses, so each multiplication has operands of about the same length even
+// when the leaves' sizes differ, and building it costs O(M(n) log n) for n limbs in total. remainders() walks the
+// same splits back down as a remainder tree, reducing x modulo every number at once for about the same cost, where
+// one division per number would take O(n) times as long. it is the multi-modular half of CRT style algorithms and
+// works for any set of positive moduli
+class ProductTree {
+private:
+	// a run of two or more leaves. its left half starts right after it in nodes, its right half at right; a half of
+	// one leaf has no node
+	struct Node {
+		BigInt value;
+		size_t split; // leaves [begin, split) go left, [split, end) right
+		size_t right;
+	};
+	std::vector<BigInt> leaf_values;
+	std::vector<Node> nodes; // nodes[0] the root, in preorder
+
+	void build(size_t begin, size_t end);
+	const BigInt& value(size_t begin, size_t end, size_t node) const;
+	void descend(const BigInt& x, size_t begin, size_t end, size_t node, std::vector<BigInt>& out) const;
+
+public:
+	explicit ProductTree(std::span<const BigInt> leaves);
+
+	size_t size() const;
+	const std::vector<BigInt>& leaves() const;
+	const BigInt& product() const; // 1 for no leaves
+
+	// x mod each leaf in [0, leaf), also for negative x. throws std::domain_error unless every leaf is positive
+	std::vector<BigInt> remainders(const BigInt& x) const;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <random>
+#include "BigInt.hpp"
+
+// random operands for the bench, tune and selfcheck drivers. every run draws the same numbers, so timings and
+// failures can be repeated
+
+inline std::mt19937_64 rng(12345);
+
+// a random non-negative number of the given count of 32-bit chunks, assembled with one shift-and-add per halving so
+// the cost stays O(M(n) log n) instead of a quadratic shift-and-add loop
+inline BigInt random_chunks(size_t chunks) {
+	if (chunks <= 1) {
+		return chunks ? BigInt((long long)(rng() & 0xffffffff)) : BigInt();
+	}
+	const size_t low = chunks / 2;
+	const BigInt high = random_chunks(chunks - low);
+	return BigInt(high.scaled(low * BITS_IN_UINT) + random_chunks(low));
+}
+
+// a random positive number of exactly n limbs
+inline BigInt random_limbs(size_t n) {
+	const size_t chunks = n * UINTS_IN_LIMB;
+	return BigInt(BigInt(1).scaled(chunks * BITS_IN_UINT - 1) + random_chunks(chunks - 1)); // top bit set
+}
@@ -0,0 +1,105 @@
+#include "../include/ScratchArena.hpp"
+#include "../include/Stats.hpp"
+#include <algorithm>
+
+namespace {
+// the arena installed on this thread by a ScratchArena::Scope, nullptr for the thread's own
+thread_local ScratchArena *installed_arena = nullptr;
+
+const size_t MIN_BLOCK_BYTES = (size_t)1 << 16;
+}
+
+std::atomic<std::pmr::memory_resource *> ScratchArena::default_upstream(nullptr);
+
+ScratchArena::ScratchArena(std::pmr::memory_resource *upstream_resource)
+    : upstream(upstream_resource), current(0), used(0) {}
+
+ScratchArena::~ScratchArena() {
+    release();
+}
+
+std::pmr::memory_resource *ScratchArena::source() const {
+    if (upstream) {
+        return upstream;
+    }
+    std::pmr::memory_resource *resource = default_upstream.load(std::memory_order_acquire);
+    return resource ? resource : std::pmr::new_delete_resource();
+}
+
+// bumps the current block, moving on to the next block (or a new one) when it is full. blocks past the current one
+// are free since the last Frame rewound to before them
+void *ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+    while (current < blocks.size()) {
+        const size_t start = (used + alignment - 1) / alignment * alignment;
+        if (start + bytes <= blocks[current].size) {
+            used = start + bytes;
+            return blocks[current].data + start;
+        }
+        if (current + 1 == blocks.size()) {
+            break;
+        }
+        ++current;
+        used = 0;
+    }
+
+    // no block has room, add one at least twice as big as the biggest so far, remembered for later operations
+    size_t biggest = 0;
+    for (const Block &block : blocks) {
+        biggest = std::max(biggest, block.size);
+    }
+    const size_t size = std::max({ bytes + alignment, 2 * biggest, MIN_BLOCK_BYTES });
+    std::pmr::memory_resource *resource = source();
+    const Block block{ static_cast<std::byte *>(resource->allocate(size, alignof(std::max_align_t))), size, resource };
+    BIGINT_STAT_BYTES(size);
+    current = blocks.empty() ? 0 : current + 1;
+    blocks.insert(blocks.begin() + current, block);
+    used = 0;
+    return do_allocate(bytes, alignment);
+}
+
+void ScratchArena::reserve(size_t bytes) {
+    Frame frame(*this);
+    frame.allocate<std::max_align_t>((bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+}
+
+void ScratchArena::release() {
+    for (const Block &block : blocks) {
+        block.resource->deallocate(block.data, block.size, alignof(std::max_align_t));
+    }
+    blocks.clear();
+    current = 0;
+    used = 0;
+}
+
+size_t ScratchArena::capacity() const {
+    size_t total = 0;
+    for (const Block &block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+ScratchArena &ScratchArena::local() {
+    thread_local ScratchArena own;
+    return installed_arena ? *installed_arena : own;
+}
+
+void ScratchArena::set_default_upstream(std::pmr::memory_resource *resource) {
+    default_upstream.store(resource, std::memory_order_release);
+}
+
+ScratchArena::Frame::Frame(ScratchArena &scratch_arena)
+    : arena(scratch_arena), block(scratch_arena.current), used(scratch_arena.used) {}
+
+ScratchArena::Frame::~Frame() {
+    arena.current = block;
+    arena.used = used;
+}
+
+ScratchArena::Scope::Scope(ScratchArena &arena) : previous(installed_arena) {
+    installed_arena = &arena;
+}
+
+ScratchArena::Scope::~Scope() {
+    installed_arena = previous;
+}
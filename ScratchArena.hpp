@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+// bump allocator for the temporaries of the recursive multiplication and division algorithms. memory is taken from
+// an upstream std::pmr::memory_resource in blocks and handed out by moving a pointer forward. a Frame remembers that
+// position and moves it back when it goes out of scope, so each level of a recursion reuses the blocks the previous
+// one used instead of going to the heap. blocks are kept for the next operation until release() or destruction.
+// deallocate() does nothing (the Frame frees), which lets std::pmr containers allocate from an arena too.
+// an arena belongs to one thread, local() is the calling thread's
+class ScratchArena : public std::pmr::memory_resource {
+private:
+	struct Block {
+		std::byte* data;
+		size_t size;
+		std::pmr::memory_resource* resource; // the one it came from, given back to it on release
+	};
+
+	std::pmr::memory_resource* upstream; // nullptr follows the default set with set_default_upstream
+	std::vector<Block> blocks;
+	size_t current; // index of the block being bumped
+	size_t used;    // bytes of blocks[current] handed out
+
+	static std::atomic<std::pmr::memory_resource*> default_upstream;
+
+	std::pmr::memory_resource* source() const;
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+	explicit ScratchArena(std::pmr::memory_resource* upstream_resource = nullptr);
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator= (const ScratchArena&) = delete;
+	~ScratchArena();
+
+	// makes sure the next bytes bytes can be handed out from one block, so a whole operation sized up front
+	// allocates upstream at most once
+	void reserve(size_t bytes);
+
+	// returns every block to the upstream resource, there must be no open Frame
+	void release();
+
+	// bytes held from the upstream resource
+	size_t capacity() const;
+
+	// the calling thread's arena: the one installed by the innermost live Scope on this thread, otherwise one the
+	// thread owns
+	static ScratchArena& local();
+
+	// upstream resource for arenas constructed without one, nullptr means std::pmr::new_delete_resource().
+	// applies to blocks allocated after the call
+	static void set_default_upstream(std::pmr::memory_resource* resource);
+
+	// marks the arena's current position, everything allocated through the arena after it is freed when the Frame
+	// is destroyed. frames on one arena must be destroyed in reverse order of construction
+	class Frame {
+	private:
+		ScratchArena& arena;
+		size_t block;
+		size_t used;
+
+	public:
+		explicit Frame(ScratchArena& scratch_arena = ScratchArena::local());
+		Frame(const Frame&) = delete;
+		Frame& operator= (const Frame&) = delete;
+		~Frame();
+
+		// n uninitialized values of trivial type T
+		template <typename T>
+		std::span<T> allocate(size_t n) {
+			return std::span<T>(static_cast<T*>(arena.allocate(n * sizeof(T), alignof(T))), n);
+		}
+	};
+
+	// makes arena the calling thread's local() arena until the Scope is destroyed. threads of an executor running
+	// parallel sub-products keep using their own arenas
+	class Scope {
+	private:
+		ScratchArena* previous;
+
+	public:
+		explicit Scope(ScratchArena& arena);
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+		~Scope();
+	};
+};
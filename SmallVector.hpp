@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include "Stats.hpp"
+
+// contiguous array of trivially copyable values that keeps up to N of them inside the object itself and only
+// spills to the heap once it grows past that. moving a heap-backed vector steals its buffer, moving an inline one
+// copies at most N values, so neither allocates
+template <typename T, size_t N>
+class SmallVector {
+private:
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector only holds trivially copyable values");
+
+	T* ptr;      // points at inline_values or at a heap block of cap values
+	size_t count;
+	size_t cap;
+	T inline_values[N];
+
+	bool is_inline() const { return ptr == inline_values; }
+
+	// move values to a heap block of exactly new_cap values (new_cap > cap)
+	void reallocate(size_t new_cap) {
+		T* new_ptr = new T[new_cap];
+		BIGINT_STAT_BYTES(new_cap * sizeof(T));
+		std::copy(ptr, ptr + count, new_ptr);
+		release();
+		ptr = new_ptr;
+		cap = new_cap;
+	}
+
+	void release() {
+		if (!is_inline()) {
+			delete[] ptr;
+		}
+	}
+
+	// take other's values, leaving other empty and inline
+	void steal(SmallVector& other) {
+		if (other.is_inline()) {
+			std::copy(other.ptr, other.ptr + other.count, inline_values);
+			ptr = inline_values;
+			cap = N;
+		} else {
+			ptr = other.ptr;
+			cap = other.cap;
+			other.ptr = other.inline_values;
+			other.cap = N;
+		}
+		count = other.count;
+		other.count = 0;
+	}
+
+public:
+	SmallVector() : ptr(inline_values), count(0), cap(N) {}
+
+	explicit SmallVector(size_t n, T value = T()) : SmallVector() {
+		resize(n, value);
+	}
+
+	template <typename It, typename = typename std::enable_if<!std::is_integral<It>::value>::type>
+	SmallVector(It first, It last) : SmallVector() {
+		assign(first, last);
+	}
+
+	SmallVector(const SmallVector& other) : SmallVector() {
+		assign(other.begin(), other.end());
+	}
+
+	SmallVector(SmallVector&& other) noexcept : SmallVector() {
+		steal(other);
+	}
+
+	~SmallVector() {
+		release();
+	}
+
+	SmallVector& operator= (const SmallVector& right) {
+		if (this != &right) {
+			assign(right.begin(), right.end()); // reuses our storage when it is big enough
+		}
+		return *this;
+	}
+
+	SmallVector& operator= (SmallVector&& right) noexcept {
+		if (this != &right) {
+			release();
+			steal(right);
+		}
+		return *this;
+	}
+
+	template <typename It>
+	void assign(It first, It last) {
+		const size_t n = (size_t)std::distance(first, last);
+		count = 0;
+		reserve(n);
+		std::copy(first, last, ptr);
+		count = n;
+	}
+
+	// grow capacity to at least n values, never shrinks
+	void reserve(size_t n) {
+		if (n > cap) {
+			reallocate(n);
+		}
+	}
+
+	// change size to n, new values are set to value
+	void resize(size_t n, T value = T()) {
+		if (n > cap) {
+			reallocate(std::max(n, 2 * cap));
+		}
+		if (n > count) {
+			std::fill(ptr + count, ptr + n, value);
+		}
+		count = n;
+	}
+
+	void push_back(T value) {
+		if (count == cap) {
+			reallocate(2 * cap);
+		}
+		ptr[count++] = value;
+	}
+
+	void pop_back() { --count; }
+	void clear() { count = 0; }
+
+	size_t size() const { return count; }
+	size_t capacity() const { return cap; }
+	bool empty() const { return count == 0; }
+
+	T* data() { return ptr; }
+	const T* data() const { return ptr; }
+	T* begin() { return ptr; }
+	const T* begin() const { return ptr; }
+	T* end() { return ptr + count; }
+	const T* end() const { return ptr + count; }
+	T& operator[] (size_t i) { return ptr[i]; }
+	const T& operator[] (size_t i) const { return ptr[i]; }
+	T& back() { return ptr[count - 1]; }
+	const T& back() const { return ptr[count - 1]; }
+};
@@ -0,0 +1,200 @@
+#include "../include/Stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#if defined(BIGINT_STATS) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+const char *Stats::name(Kind kind) {
+    static const char *const NAMES[KINDS] = {
+        "sum", "mul", "sqr", "div", "pow", "powmod", "gcd", "to_string", "to_string2", "to_binary_string", "parse",
+        "mul_basecase", "mul_karatsuba", "mul_toom3", "mul_toom4", "mul_ntt", "sqr_basecase", "sqr_karatsuba",
+        "divrem_1", "divrem_basecase", "divrem_bz", "gcd_lehmer", "gcd_hgcd",
+    };
+    return NAMES[kind];
+}
+
+void Stats::Snapshot::write(std::ostream &out) const {
+    for (size_t kind = 0; kind < KINDS; ++kind) {
+        const Counter &counter = counters[kind];
+        if (counter.calls == 0) {
+            continue;
+        }
+        out << name((Kind)kind) << ": calls " << counter.calls << ", cycles " << counter.cycles << ", bytes "
+            << counter.bytes << ", sizes";
+        for (size_t i = 0; i < SIZE_BUCKETS; ++i) {
+            if (counter.sizes[i]) {
+                out << " [" << ((uint64_t)1 << i) << ", " << ((uint64_t)2 << i) << "): " << counter.sizes[i];
+            }
+        }
+        out << '\n';
+    }
+    for (const auto &[trace_name, trace] : traces) {
+        out << "trace " << trace_name << ": calls " << trace.calls << ", cycles " << trace.cycles << ", bytes "
+            << trace.bytes << '\n';
+    }
+}
+
+#ifdef BIGINT_STATS
+
+namespace {
+uint64_t cycles_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// a Stats::Counter of one thread. only that thread writes it, even reset() leaves it alone, and snapshot() reads it
+// from others, so the atomics are only there to make those reads well defined: updates are a relaxed load and
+// store, no locked instruction
+struct ThreadCounter {
+    std::atomic<uint64_t> calls{ 0 }, cycles{ 0 }, bytes{ 0 };
+    std::array<std::atomic<uint64_t>, Stats::SIZE_BUCKETS> sizes{};
+};
+
+void add(std::atomic<uint64_t> &value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct ThreadStats {
+    std::array<ThreadCounter, Stats::KINDS> counters;
+    uint64_t allocated = 0; // bytes allocated by this thread so far, only read by this thread
+
+    ThreadStats();
+    ~ThreadStats();
+};
+
+// the counters of live threads, and the totals threads left behind when they exited plus every trace since the
+// last reset. never destroyed, so threads that end during static destruction (e.g. those of a ThreadPool) can
+// still hand theirs in
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadStats *> threads;
+    Stats::Snapshot finished;
+    std::array<Stats::Counter, Stats::KINDS> baseline; // the counter totals at the last reset, which never decrease
+};
+
+Registry &registry() {
+    static Registry *instance = new Registry();
+    return *instance;
+}
+
+ThreadStats &local_stats() {
+    thread_local ThreadStats stats;
+    return stats;
+}
+
+void accumulate(Stats::Counter &total, const ThreadCounter &counter) {
+    total.calls += counter.calls.load(std::memory_order_relaxed);
+    total.cycles += counter.cycles.load(std::memory_order_relaxed);
+    total.bytes += counter.bytes.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < Stats::SIZE_BUCKETS; ++i) {
+        total.sizes[i] += counter.sizes[i].load(std::memory_order_relaxed);
+    }
+}
+
+ThreadStats::ThreadStats() {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    registry().threads.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t kind = 0; kind < Stats::KINDS; ++kind) {
+        accumulate(r.finished.counters[kind], counters[kind]);
+    }
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+}
+
+// the counters of every thread since it started, with the registry locked
+std::array<Stats::Counter, Stats::KINDS> totals(const Registry &r) {
+    std::array<Stats::Counter, Stats::KINDS> total = r.finished.counters;
+    for (const ThreadStats *thread : r.threads) {
+        for (size_t kind = 0; kind < Stats::KINDS; ++kind) {
+            accumulate(total[kind], thread->counters[kind]);
+        }
+    }
+    return total;
+}
+
+size_t size_bucket(size_t size) {
+    return std::min<size_t>(size > 1 ? std::bit_width(size) - 1 : 0, Stats::SIZE_BUCKETS - 1);
+}
+} // namespace
+
+Stats::Snapshot Stats::snapshot() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    Snapshot snapshot;
+    snapshot.counters = totals(r);
+    snapshot.traces = r.finished.traces;
+    for (size_t kind = 0; kind < KINDS; ++kind) {
+        Counter &counter = snapshot.counters[kind];
+        const Counter &base = r.baseline[kind];
+        counter.calls -= base.calls;
+        counter.cycles -= base.cycles;
+        counter.bytes -= base.bytes;
+        for (size_t i = 0; i < SIZE_BUCKETS; ++i) {
+            counter.sizes[i] -= base.sizes[i];
+        }
+    }
+    return snapshot;
+}
+
+// remembers the totals instead of zeroing the threads' counters, which only their owners write
+void Stats::reset() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.baseline = totals(r);
+    r.finished.traces.clear();
+}
+
+Stats::Scope::Scope(Kind kind_in, size_t size) : kind(kind_in), start_cycles(cycles_now()), start_bytes(local_stats().allocated) {
+    ThreadCounter &counter = local_stats().counters[kind];
+    add(counter.calls, 1);
+    add(counter.sizes[size_bucket(size)], 1);
+}
+
+Stats::Scope::~Scope() {
+    ThreadStats &stats = local_stats();
+    ThreadCounter &counter = stats.counters[kind];
+    add(counter.cycles, cycles_now() - start_cycles);
+    add(counter.bytes, stats.allocated - start_bytes);
+}
+
+Stats::TraceScope::TraceScope(const char *name_in)
+    : name(name_in), start_cycles(cycles_now()), start_bytes(local_stats().allocated) {}
+
+Stats::TraceScope::~TraceScope() {
+    const uint64_t cycles = cycles_now() - start_cycles;
+    const uint64_t bytes = local_stats().allocated - start_bytes;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    Trace &trace = r.finished.traces[name];
+    ++trace.calls;
+    trace.cycles += cycles;
+    trace.bytes += bytes;
+}
+
+void Stats::count_bytes(size_t bytes) {
+    local_stats().allocated += bytes;
+}
+
+#else
+
+Stats::Snapshot Stats::snapshot() {
+    return Snapshot();
+}
+
+void Stats::reset() {}
+
+void Stats::count_bytes(size_t) {}
+
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+// operation statistics, compiled in by defining BIGINT_STATS (for the library and the code using it alike, like
+// BIGINT_64BIT_LIMBS). every BigInt operation and every mpn algorithm tier it runs counts its calls, a histogram of
+// its operand sizes, the bytes it allocated and the cycles it took. counts are kept per thread and summed by
+// snapshot(). cycles and bytes are inclusive: a multiplication's cycles include those of the karatsuba and
+// basecase calls under it, which count for themselves too. without BIGINT_STATS nothing is recorded, the hooks
+// compile to nothing and snapshot() is all zeros
+class Stats {
+public:
+	// what a counter belongs to: BigInt operations first, then the mpn algorithms they pick
+	enum Kind {
+		SUM,              // +, - and LinearSum evaluation
+		MUL,
+		SQR,
+		DIV,              // divmod and everything built on it: /, %, /= and %=
+		POW,
+		POWMOD,           // ModularContext::powmod
+		GCD,              // gcd, extended_gcd and mod_inverse
+		TO_STRING,
+		TO_STRING2,
+		TO_BINARY_STRING,
+		PARSE,
+		MUL_BASECASE,
+		MUL_KARATSUBA,
+		MUL_TOOM3,
+		MUL_TOOM4,
+		MUL_NTT,
+		SQR_BASECASE,
+		SQR_KARATSUBA,
+		DIVREM_1,
+		DIVREM_BASECASE,
+		DIVREM_BZ,
+		GCD_LEHMER,
+		GCD_HGCD,
+		KINDS
+	};
+
+	static const size_t SIZE_BUCKETS = 32;
+
+	struct Counter {
+		uint64_t calls = 0;
+		uint64_t cycles = 0; // time stamp counter ticks on x86, nanoseconds elsewhere
+		uint64_t bytes = 0;  // heap memory taken for digit storage and scratch arena blocks
+		std::array<uint64_t, SIZE_BUCKETS> sizes{}; // sizes[i] counts calls whose larger operand had [2^i, 2^(i+1)) digits, 0 digits count as 1
+	};
+
+	struct Trace {
+		uint64_t calls = 0;
+		uint64_t cycles = 0;
+		uint64_t bytes = 0;
+	};
+
+	struct Snapshot {
+		std::array<Counter, KINDS> counters;
+		std::map<std::string, Trace> traces; // by TraceScope name
+
+		const Counter& operator[] (Kind kind) const { return counters[kind]; }
+
+		// one line per kind and trace that was used
+		void write(std::ostream& out) const;
+	};
+
+	static constexpr bool enabled() {
+#ifdef BIGINT_STATS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	static const char* name(Kind kind);
+
+	// the totals of every thread since the last reset (or the start), threads that have exited since included
+	static Snapshot snapshot();
+
+	// starts the counts over: records the counter totals as a baseline that later snapshots subtract, and drops
+	// the traces. no counter is zeroed, the threads' own are not written at all, so each update by an operation
+	// running meanwhile falls on one side of the reset and none is lost or undone
+	static void reset();
+
+	// records one call of kind with operands of size digits from construction to destruction. used through
+	// BIGINT_STAT_SCOPE, which compiles to nothing without BIGINT_STATS
+	class Scope {
+	private:
+		Kind kind;
+		uint64_t start_cycles;
+		uint64_t start_bytes;
+
+	public:
+		Scope(Kind kind_in, size_t size);
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+		~Scope();
+	};
+
+	// attributes the cycles and bytes of everything the calling thread runs while it exists to name, e.g. a
+	// TraceScope around a request handler shows what that handler spends in the library. scopes may nest, each
+	// counts everything inside it. does nothing without BIGINT_STATS
+	class TraceScope {
+#ifdef BIGINT_STATS
+	private:
+		const char* name;
+		uint64_t start_cycles;
+		uint64_t start_bytes;
+
+	public:
+		explicit TraceScope(const char* name_in);
+		~TraceScope();
+#else
+	public:
+		explicit TraceScope(const char*) {}
+#endif
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator= (const TraceScope&) = delete;
+	};
+
+	// adds bytes to the calling thread's allocation count, through BIGINT_STAT_BYTES
+	static void count_bytes(size_t bytes);
+};
+
+#ifdef BIGINT_STATS
+#define BIGINT_STAT_SCOPE(kind, size) Stats::Scope bigint_stat_scope(Stats::kind, size)
+#define BIGINT_STAT_BYTES(bytes) Stats::count_bytes(bytes)
+#else
+#define BIGINT_STAT_SCOPE(kind, size) ((void)0)
+#define BIGINT_STAT_BYTES(bytes) ((void)0)
+#endif
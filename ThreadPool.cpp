@@ -0,0 +1,124 @@
+#include "../include/ThreadPool.hpp"
+
+namespace {
+// the pool the current thread works for and the index of its queue, so nested batches stay on that queue
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_index = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads) : queued(0), stopping(false) {
+    if (threads == 0) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::concurrency() const {
+    return queues.size();
+}
+
+size_t ThreadPool::own_queue() const {
+    return current_pool == this ? current_index : 0;
+}
+
+// pops from the back of our own queue, otherwise steals from the front of the others
+bool ThreadPool::find_task(size_t index, Task &task) {
+    for (size_t k = 0; k < queues.size(); ++k) {
+        Queue &queue = *queues[(index + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            if (k == 0) {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            } else {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::execute(const Task &task) {
+    try {
+        (*task.function)();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(task.batch->error_mutex);
+        if (!task.batch->error) {
+            task.batch->error = std::current_exception();
+        }
+    }
+    task.batch->remaining.fetch_sub(1, std::memory_order_release); // last touch of the batch, run() may return now
+}
+
+void ThreadPool::work(size_t index) {
+    current_pool = this;
+    current_index = index;
+    Task task;
+    while (true) {
+        if (find_task(index, task)) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::run(std::span<const std::function<void()>> tasks) {
+    if (tasks.size() <= 1 || queues.size() == 1) {
+        for (const std::function<void()> &task : tasks) {
+            task();
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.remaining.store(tasks.size());
+    const size_t index = own_queue();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        for (size_t i = tasks.size(); i-- > 1;) { // pushed so we pop them back in order
+            queues[index]->tasks.push_back(Task{ &tasks[i], &batch });
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued.fetch_add(tasks.size() - 1);
+    }
+    wake.notify_all();
+
+    execute(Task{ &tasks[0], &batch });
+    Task task;
+    while (batch.remaining.load(std::memory_order_acquire) > 0) {
+        if (find_task(index, task)) {
+            execute(task);
+        } else {
+            std::this_thread::yield(); // the rest of the batch is running on other threads
+        }
+    }
+    if (batch.error) {
+        std::rethrow_exception(batch.error);
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+// runs batches of independent tasks for the parallel multiplication algorithms. implement this to hand the work
+// to an existing scheduler, or use ThreadPool
+class Executor {
+public:
+	virtual ~Executor() = default;
+
+	// runs every task and returns once all of them have finished, rethrowing the first exception any of them threw.
+	// tasks call run() again for their own sub-products, so a thread waiting on a batch must keep working on
+	// queued tasks rather than block
+	virtual void run(std::span<const std::function<void()>> tasks) = 0;
+
+	// number of threads tasks can run on at once, used to decide how finely to split loops
+	virtual size_t concurrency() const = 0;
+};
+
+// work-stealing pool. every thread keeps its own deque of tasks, takes new work from the back of it (the most
+// recently split, smallest sub-products) and steals from the front of other threads' deques (the biggest ones)
+// when it runs dry. a thread that is waiting on a batch runs queued tasks until its batch completes
+class ThreadPool : public Executor {
+private:
+	struct Batch {
+		std::atomic<size_t> remaining;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	};
+	struct Task {
+		const std::function<void()>* function;
+		Batch* batch;
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues; // queues[0] is shared by threads from outside the pool
+	std::vector<std::thread> workers;
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic<size_t> queued;
+	bool stopping;
+
+	size_t own_queue() const;
+	bool find_task(size_t index, Task& task);
+	static void execute(const Task& task);
+	void work(size_t index);
+
+public:
+	// threads counts the calling thread, which works on its own batches while it waits, so threads - 1 workers are
+	// started. 0 means one per hardware thread
+	explicit ThreadPool(size_t threads = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator= (const ThreadPool&) = delete;
+
+	void run(std::span<const std::function<void()>> tasks) override;
+	size_t concurrency() const override;
+};
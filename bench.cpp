@@ -0,0 +1,215 @@
+#include "../include/BigInt.hpp"
+#include "../include/RandomOperands.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+// benchmark driver: times every arithmetic tier and conversion over operand sizes from 1 limb up, and writes the
+// results as JSON or CSV so runs from two versions can be compared. see usage() for the options
+
+namespace {
+
+struct Options {
+    size_t max_limbs = 10000000;
+    double min_time = 0.2;    // seconds of timed batches per measurement
+    double max_seconds = 5.0; // an operation stops growing once a single call takes longer than this
+    size_t threads = 1;
+    std::string format = "json";
+    std::string out;
+    std::vector<std::string> ops;
+};
+
+struct Result {
+    std::string op;
+    size_t limbs;
+    size_t iterations;
+    double ns_per_op;
+};
+
+// one benchmarked operation: prepare(n) builds the inputs for n limb operands outside the timing, run() is timed
+struct Benchmark {
+    std::string name;
+    std::function<void(size_t)> prepare;
+    std::function<void()> run;
+};
+
+// 1, 2, 5, 10, 20, 50, ... up to max_limbs
+std::vector<size_t> sweep_sizes(size_t max_limbs) {
+    std::vector<size_t> sizes;
+    for (size_t decade = 1;; decade *= 10) {
+        for (size_t step : { 1, 2, 5 }) {
+            if (decade * step > max_limbs) {
+                return sizes;
+            }
+            sizes.push_back(decade * step);
+        }
+    }
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// runs f in batches sized to take about min_time / 5 each and returns the best batch's time per call, which is the
+// least disturbed by the rest of the machine
+Result measure(const std::string &name, size_t limbs, const std::function<void()> &f, double min_time) {
+    auto start = std::chrono::steady_clock::now();
+    f(); // warm-up, also tells how long one call takes
+    const double once = seconds_since(start);
+    const size_t batch = std::max<size_t>(1, (size_t)(min_time / 5 / std::max(once, 1e-9)));
+    double best = once;
+    size_t iterations = 1;
+    double total = 0;
+    for (int round = 0; round < 5 && total < min_time; ++round) {
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; ++i) {
+            f();
+        }
+        const double elapsed = seconds_since(start);
+        best = std::min(best, elapsed / batch);
+        iterations += batch;
+        total += elapsed;
+    }
+    return Result{ name, limbs, iterations, best * 1e9 };
+}
+
+std::vector<Benchmark> benchmarks() {
+    // inputs shared by the closures, rebuilt by each prepare
+    static BigInt a, b, divisor, dividend;
+    static ulonglong exponent;
+    static std::string decimal;
+    return {
+        { "add", [](size_t n) { a = random_limbs(n); b = random_limbs(n); }, [] { BigInt(a + b).num_digits(); } },
+        { "sub", [](size_t n) { a = random_limbs(n); b = random_limbs(n); }, [] { BigInt(a - b).num_digits(); } },
+        { "mul", [](size_t n) { a = random_limbs(n); b = random_limbs(n); }, [] { (a * b).num_digits(); } },
+        { "sqr", [](size_t n) { a = random_limbs(n); }, [] { a.square().num_digits(); } },
+        { "div", [](size_t n) { dividend = random_limbs(2 * n); divisor = random_limbs(n); }, [] { (dividend / divisor).num_digits(); } },
+        { "pow", [](size_t n) { exponent = (ulonglong)(n * BITS_IN_LIMB / std::log2(3.0)); }, [] { BigInt::pow(BigInt(3), exponent).num_digits(); } },
+        { "to_string", [](size_t n) { a = random_limbs(n); }, [] { a.to_string().size(); } },
+        { "to_string2", [](size_t n) { a = random_limbs(n); }, [] { a.to_string2().size(); } },
+        { "to_binary_string", [](size_t n) { a = random_limbs(n); }, [] { a.to_binary_string().size(); } },
+        { "parse", [](size_t n) { decimal = random_limbs(n).to_string(); }, [] { BigInt(decimal).num_digits(); } },
+        { "shl", [](size_t n) { a = random_limbs(n); }, [] { (a << 77).num_digits(); } },
+        { "and", [](size_t n) { a = random_limbs(n); b = BigInt(0) - random_limbs(n); }, [] { (a & b).num_digits(); } },
+        { "to_hex", [](size_t n) { a = random_limbs(n); }, [] { a.to_string(16).size(); } },
+        { "parse_hex", [](size_t n) { decimal = random_limbs(n).to_string(16); }, [] { BigInt(decimal, 16).num_digits(); } },
+        { "gcd", [](size_t n) { a = random_limbs(n); b = random_limbs(n); }, [] { BigInt::gcd(a, b).num_digits(); } },
+        { "gcdext", [](size_t n) { a = random_limbs(n); b = random_limbs(n); },
+          [] { BigInt g, x, y; BigInt::extended_gcd(a, b, g, x, y); g.num_digits(); } },
+    };
+}
+
+void write_json(std::ostream &out, const Options &options, const std::vector<Result> &results) {
+    out << "{\n  \"limb_bits\": " << BITS_IN_LIMB << ",\n  \"threads\": " << options.threads << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        char line[256];
+        std::snprintf(line, sizeof(line),
+            "    {\"op\": \"%s\", \"limbs\": %zu, \"iterations\": %zu, \"ns_per_op\": %.1f, \"ns_per_limb\": %.4f, \"limbs_per_second\": %.6g}%s\n",
+            r.op.c_str(), r.limbs, r.iterations, r.ns_per_op, r.ns_per_op / r.limbs, r.limbs * 1e9 / r.ns_per_op,
+            i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+void write_csv(std::ostream &out, const std::vector<Result> &results) {
+    out << "op,limb_bits,limbs,iterations,ns_per_op,ns_per_limb,limbs_per_second\n";
+    for (const Result &r : results) {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s,%zu,%zu,%zu,%.1f,%.4f,%.6g\n", r.op.c_str(), BITS_IN_LIMB, r.limbs,
+            r.iterations, r.ns_per_op, r.ns_per_op / r.limbs, r.limbs * 1e9 / r.ns_per_op);
+        out << line;
+    }
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: bench [options]\n"
+        "  --ops a,b,...       operations to run (default all): add sub mul sqr div pow to_string to_string2\n"
+        "                      to_binary_string parse shl and to_hex parse_hex gcd gcdext\n"
+        "  --max-limbs N       largest operand size in limbs (default 10000000), sizes go 1, 2, 5, 10, 20, ...\n"
+        "  --min-time S        seconds spent timing each measurement (default 0.2)\n"
+        "  --max-seconds S     stop growing an operation once one call takes longer (default 5)\n"
+        "  --threads N         run large multiplications on N threads (default 1)\n"
+        "  --format json|csv   output format (default json)\n"
+        "  --out FILE          write the results to FILE instead of stdout\n");
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char *value = argv[++i];
+        if (arg == "--ops") {
+            std::stringstream list(value);
+            for (std::string op; std::getline(list, op, ',');) {
+                options.ops.push_back(op);
+            }
+        } else if (arg == "--max-limbs") {
+            options.max_limbs = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--min-time") {
+            options.min_time = std::strtod(value, nullptr);
+        } else if (arg == "--max-seconds") {
+            options.max_seconds = std::strtod(value, nullptr);
+        } else if (arg == "--threads") {
+            options.threads = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--format" && (std::strcmp(value, "json") == 0 || std::strcmp(value, "csv") == 0)) {
+            options.format = value;
+        } else if (arg == "--out") {
+            options.out = value;
+        } else {
+            return false;
+        }
+    }
+    return options.max_limbs > 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+    BigInt::set_thread_count(options.threads);
+
+    std::vector<Result> results;
+    for (const Benchmark &benchmark : benchmarks()) {
+        if (!options.ops.empty() && std::find(options.ops.begin(), options.ops.end(), benchmark.name) == options.ops.end()) {
+            continue;
+        }
+        for (size_t n : sweep_sizes(options.max_limbs)) {
+            benchmark.prepare(n);
+            const Result result = measure(benchmark.name, n, benchmark.run, options.min_time);
+            results.push_back(result);
+            std::fprintf(stderr, "%-16s %9zu limbs %14.1f ns %10.3f ns/limb\n", result.op.c_str(), n, result.ns_per_op,
+                result.ns_per_op / n);
+            if (result.ns_per_op > options.max_seconds * 1e9) {
+                std::fprintf(stderr, "%-16s stopping, one call takes over %g s\n", benchmark.name.c_str(), options.max_seconds);
+                break;
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!options.out.empty()) {
+        file.open(options.out);
+        if (!file) {
+            std::fprintf(stderr, "cannot open %s\n", options.out.c_str());
+            return 1;
+        }
+    }
+    std::ostream &out = options.out.empty() ? std::cout : file;
+    if (options.format == "json") {
+        write_json(out, options, results);
+    } else {
+        write_csv(out, results);
+    }
+    return 0;
+}
@@ -1,19 +1,29 @@
 #include "../include/BigInt.hpp"
+#include <thread>
 
 int main() {
+	BigInt::set_thread_count(std::thread::hardware_concurrency());
+
+	// the numbers are made one after another, the decimal conversions a block at a time with to_string_batch
+	const size_t BLOCK = 1024;
+	std::vector<BigInt> fibs;
+	std::vector<std::string> decimals(BLOCK);
 	BigInt b1 = 0;
 	BigInt b2 = 1;
-	BigInt b3 = 1;
-	std::cout << "fib[0]: " << b1.to_string() << '\n';
-	std::cout << "fib[1]: " << b2.to_string() << '\n';
-	for (int i = 2; i <= 100000; ++i) {
-		std::cout << "fib[" << i << "]: " << b3.to_string() << '\n';
-		b1 = b2;
-		b2 = b3;
-		b3 = b1 + b2;
+	for (int start = 0; start <= 100000; start += BLOCK) {
+		fibs.clear();
+		for (int i = start; i < start + (int)BLOCK && i <= 100000; ++i) {
+			fibs.push_back(b1);
+			b1 = b2 + b1;
+			std::swap(b1, b2);
+		}
+		BigInt::to_string_batch(fibs, std::span<std::string>(decimals).first(fibs.size()));
+		for (size_t j = 0; j < fibs.size(); ++j) {
+			std::cout << "fib[" << start + j << "]: " << decimals[j] << '\n';
+		}
 	}
 	std::cout << "done!\n";
-	std::cout << b3.to_string() << '\n';
+	std::cout << b1.to_string() << '\n';
 
 	return 0;
 }
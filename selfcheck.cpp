@@ -0,0 +1,535 @@
+#include "../include/BigInt.hpp"
+#include "../include/FixedInt.hpp"
+#include "../include/ModularContext.hpp"
+#include "../include/Mpn.hpp"
+#include "../include/ProductTree.hpp"
+#include "../include/RandomOperands.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+// self-check: runs the operations with thresholds low enough for small operands to reach every fast tier, and
+// compares the results with those of the basecase algorithms on the same operands. it also checks what each
+// operation promises on its own (e.g. the division identity). run it after changing a kernel or a threshold, it
+// prints every mismatch and exits with 1 if there was one. see usage() for the options
+
+namespace {
+
+const size_t NEVER = (size_t)1 << 40; // a threshold no operand reaches
+
+struct Options {
+    size_t max_limbs = 600;
+    size_t rounds = 2;
+};
+
+// what the operations run with: the thresholds, the limb kernels and the number of threads
+struct Config {
+    const char *name;
+    Thresholds thresholds;
+    mpn::cpu_features kernels = mpn::detect_cpu_features();
+    size_t threads = 1;
+};
+
+// every fast tier switched off: the reference
+Thresholds basecase() {
+    Thresholds t;
+    t.karatsuba = t.sqr_karatsuba = t.toom3 = t.toom4 = t.ntt = t.burnikel_ziegler = NEVER;
+    t.to_string = t.parse = t.hgcd = NEVER;
+    return t;
+}
+
+// the fast tiers from a few limbs up, stacked so the sizes checked pass through all of them in turn
+Thresholds small() {
+    Thresholds t;
+    t.karatsuba = 4;
+    t.burnikel_ziegler = 4;
+    t.ntt = 128;
+    t.to_string = 4;
+    t.parse = 1;
+    t.toom3 = 16;
+    t.toom4 = 48;
+    t.sqr_karatsuba = 4;
+    t.hgcd = 4;
+    return t;
+}
+
+const Config reference = { "basecase", basecase(), mpn::cpu_features(), 1 }; // the generic kernels as well
+std::vector<Config> configs; // what is compared with the reference, configs[0] is the default
+const Config *current = nullptr;
+
+void apply(const Config &config) {
+    current = &config;
+    BigInt::set_thresholds(config.thresholds);
+    mpn::select_kernels(config.kernels);
+    BigInt::set_thread_count(config.threads);
+}
+
+size_t checks = 0;
+size_t failures = 0;
+
+void check(bool ok, const char *what, size_t n) {
+    ++checks;
+    if (!ok) {
+        ++failures;
+        std::fprintf(stderr, "FAIL %s with %s at %zu limbs\n", what, current->name, n);
+    }
+}
+
+// runs f under the reference and then under each config, and reports every config whose results differ. f also
+// checks the identities its operation promises, so those are checked under every config too
+template <typename F>
+void compare(const char *what, size_t n, F f) {
+    apply(reference);
+    const auto expected = f();
+    for (const Config &config : configs) {
+        apply(config);
+        check(f() == expected, what, n);
+    }
+    apply(configs[0]);
+}
+
+BigInt abs(const BigInt &x) {
+    return x < 0 ? -x : x;
+}
+
+// a random number of n limbs, negative half of the time
+BigInt random_signed(size_t n) {
+    BigInt x = random_limbs(n);
+    return rng() & 1 ? -x : x;
+}
+
+// 1, 2, 3, 4, 5, 6, 8, 10, 12, 16, ... growing by about a quarter up to max_limbs
+std::vector<size_t> sizes(size_t max_limbs) {
+    std::vector<size_t> result;
+    for (size_t n = 1; n <= max_limbs; n = std::max(n + 1, n + n / 4)) {
+        result.push_back(n);
+    }
+    return result;
+}
+
+// quotient and remainder truncate toward zero, the remainder takes the dividend's sign
+void check_division(size_t n) {
+    const BigInt a = random_signed(2 * n), b = random_signed(n), c = random_signed(n / 3 + 1);
+    compare("divmod", n, [&] {
+        std::vector<BigInt> results;
+        for (const auto &[x, y] : { std::pair(a, b), std::pair(a, c), std::pair(a * c + b, c), std::pair(b, a) }) {
+            BigInt q, r;
+            BigInt::divmod(x, y, q, r);
+            check(q * y + r == x && abs(r) < abs(y) && (r == 0 || (r < 0) == (x < 0)), "divmod identity", n);
+            results.push_back(q);
+            results.push_back(r);
+        }
+        return results;
+    });
+}
+
+void check_multiplication(size_t n) {
+    const BigInt a = random_signed(n), b = random_signed(n);
+    compare("mul", n, [&] {
+        const BigInt product = a * b;
+        check(product.num_digits() + 1 >= 2 * n && (product < 0) == ((a < 0) != (b < 0)), "mul size and sign", n);
+        return std::vector<BigInt>{ product };
+    });
+}
+
+void check_to_string(size_t n) {
+    const BigInt a = random_signed(n);
+    compare("to_string", n, [&] {
+        return std::vector<std::string>{ a.to_string(), (a * a).to_string() };
+    });
+}
+
+void check_parse(size_t n) {
+    const BigInt a = random_signed(n);
+    const std::string decimal = a.to_string();
+    compare("parse", n, [&] {
+        std::istringstream stream(decimal + " rest");
+        const BigInt parsed(decimal), read(stream);
+        check(parsed == a && read == a, "parse of to_string", n);
+        return std::vector<BigInt>{ parsed, read };
+    });
+}
+
+// the dispatched kernels: add_n, sub_n and cmp through + and - and the comparisons, mul_1 and addmul_1 through a
+// product with one limb
+void check_kernels(size_t n) {
+    const BigInt a = random_signed(n), b = random_signed(n), c = random_limbs(1);
+    compare("add, sub, compare and mul_1", n, [&] {
+        const BigInt sum = a + b, difference = a - b;
+        check(sum - b == a && difference + b == a && (a < b) == (difference < 0), "add and sub identities", n);
+        return std::vector<BigInt>{ sum, difference, b - a, a * c, c * b + a, a < b, a == b, abs(a) > abs(b) };
+    });
+}
+
+// parts of uneven length: a Toom split of n limbs leaves a short top part unless n divides evenly
+void check_toom(size_t n) {
+    const BigInt a = random_signed(n + 1), b = random_signed(n + 2);
+    compare("mul with uneven parts", n, [&] {
+        return std::vector<BigInt>{ a * b, b * a };
+    });
+}
+
+void check_unbalanced(size_t n) {
+    const BigInt a = random_signed(5 * n), b = random_signed(n), c = random_signed(n / 3 + 1);
+    compare("unbalanced mul", n, [&] {
+        return std::vector<BigInt>{ a * b, b * a, a * c, b * c };
+    });
+}
+
+void check_square(size_t n) {
+    const BigInt a = random_signed(n);
+    compare("sqr", n, [&] {
+        const BigInt square = a.square();
+        check(square == a * BigInt(a) && square >= 0, "square equals the product", n);
+        return std::vector<BigInt>{ square, a * a };
+    });
+}
+
+void check_pow(size_t n) {
+    const BigInt base = random_signed(n / 8 + 1);
+    const ulonglong exponent = rng() % 13;
+    compare("pow", n, [&] {
+        BigInt repeated = 1;
+        for (ulonglong i = 0; i < exponent; ++i) {
+            repeated *= base;
+        }
+        const BigInt power = BigInt::pow(base, exponent);
+        check(power == repeated && BigInt::pow(base, BigInt((long long)exponent)) == power, "pow", n);
+        return std::vector<BigInt>{ power, BigInt::pow(base, 0), BigInt::pow(BigInt(-1), exponent) };
+    });
+}
+
+// the montgomery path for an odd modulus and the division path for an even one, both against square and multiply
+// with plain divisions
+void check_modular(size_t n) {
+    const BigInt odd = random_limbs(n / 4 + 1) | 1, even = random_limbs(n / 4 + 1) << 1;
+    const BigInt a = random_signed(n / 2 + 1), b = random_signed(n / 4 + 1), exponent = random_limbs(2);
+    compare("ModularContext", n, [&] {
+        std::vector<BigInt> results;
+        for (const BigInt &m : { odd, even }) {
+            const ModularContext context(m);
+            BigInt expected = 1, square = context.reduce(a);
+            for (size_t i = 0; i < exponent.bit_length(); ++i) {
+                if (((exponent >> i) & 1) == 1) {
+                    expected = expected * square % m;
+                }
+                square = square * square % m;
+            }
+            const BigInt product = context.mulmod(a, b), power = context.powmod(a, exponent);
+            check(product == (a % m * (b % m) % m + m) % m, "mulmod", n);
+            check(context.sqrmod(a) == a * a % m, "sqrmod", n);
+            check(power == expected, "powmod", n);
+            results.insert(results.end(), { product, power, context.powmod(b, 0), context.reduce(-a) });
+        }
+        return results;
+    });
+}
+
+// chains of scaled terms with mixed signs, assigned to a new BigInt and to one of their own operands
+void check_linear_sum(size_t n) {
+    const BigInt a = random_signed(n), b = random_signed(n / 2 + 1), c = random_signed(2 * n);
+    const size_t s = rng() % (2 * BITS_IN_LIMB);
+    compare("LinearSum", n, [&] {
+        const BigInt sum = a.scaled(s) - b + c.scaled(BITS_IN_LIMB) - a.scaled(3) + b.scaled(s + 1);
+        check(sum == (a << s) - b + (c << BITS_IN_LIMB) - (a << 3) + (b << (s + 1)), "LinearSum chain", n);
+        BigInt x = c;
+        x = x.scaled(s) - x + b;
+        check(x == (c << s) - c + b, "LinearSum assigned to an operand", n);
+        BigInt y = a;
+        y += b.scaled(s);
+        check(y == a + (b << s) && a - (a + b) == -b, "LinearSum added in place", n);
+        return std::vector<BigInt>{ sum, x, y };
+    });
+}
+
+// every way in and out of the binary format, including two numbers back to back
+void check_binary(const BigInt &x, const BigInt &y, size_t n) {
+    const std::vector<std::byte> bytes = x.to_binary();
+    check(bytes.size() == x.binary_size() && BigInt::from_binary(bytes) == x, "binary round trip", n);
+
+    std::stringstream stream;
+    x.write_binary(stream);
+    y.write_binary(stream);
+    const BigInt first = BigInt::read_binary(stream);
+    const BigInt second = BigInt::read_binary(stream);
+    check(stream && first == x && second == y, "write_binary and read_binary", n);
+
+    std::vector<std::byte> both = bytes;
+    const std::vector<std::byte> more = y.to_binary();
+    both.insert(both.end(), more.begin(), more.end());
+    const BinaryView view = BigInt::view_binary(both);
+    const BinaryView next = BigInt::view_binary(std::span<const std::byte>(both).subspan(view.size));
+    check(view.size == bytes.size() && BigInt(view.scaled()) == x && BigInt(next.scaled()) == y, "view_binary", n);
+
+    bool thrown = false;
+    try {
+        BigInt::from_binary(std::span<const std::byte>(bytes).first(bytes.size() - 1));
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    check(thrown, "from_binary of a cut short number", n);
+}
+
+// two's complement semantics, by identities that hold for any x and y
+void check_bitwise(size_t n) {
+    const BigInt x = random_signed(n), y = random_signed(n / 2 + 1);
+    const size_t s = rng() % (3 * BITS_IN_LIMB);
+    compare("bitwise and shifts", n, [&] {
+        const BigInt both = x & y, either = x | y, one = x ^ y;
+        check(~x == -x - 1 && both + either == x + y && one == either - both, "and, or, xor identities", n);
+        check(~(x & y) == (~x | ~y) && (x & ~y) + both == x, "and, or, not identities", n);
+        check((x << s) == x * BigInt::pow(2, s), "<<", n);
+        const BigInt power = BigInt::pow(2, s);
+        BigInt q = x / power;
+        if (x < 0 && q * power != x) {
+            q -= 1;
+        }
+        check((x >> s) == q && ((x << s) >> s) == x, ">> rounds toward negative infinity", n);
+        for (unsigned base : { 2u, 8u, 10u, 16u }) {
+            check(BigInt(x.to_string(base), base) == x, "to_string and parse in base 2, 8, 10 and 16", n);
+        }
+        return std::vector<BigInt>{ both, either, one, ~x, x << s, x >> s };
+    });
+}
+
+// FixedInt<Bits> against BigInt arithmetic modulo 2^Bits. the other way round, FixedInt's limb by limb bitwise
+// operations check BigInt's two's complement ones on negative numbers
+template <size_t Bits>
+void check_fixed(size_t n) {
+    const BigInt mask = (BigInt(1) << Bits) - 1;
+    const auto wrap = [&](const BigInt &value) { return value & mask; }; // two's complement makes it mod 2^Bits
+    const BigInt c = random_signed(n), d = random_signed(n / 2 + 1);
+    const BigInt a = wrap(c), b = wrap(d) | 1;
+    const size_t s = rng() % Bits;
+    compare("FixedInt", n, [&] {
+        const FixedInt<Bits> x(a), y(b);
+        check((x + y).to_bigint() == wrap(a + b) && (x - y).to_bigint() == wrap(a - b) &&
+                (x * y).to_bigint() == wrap(a * b) && x.mul_wide(y).to_bigint() == a * b, "FixedInt + - *", n);
+        check((x / y).to_bigint() == a / b && (x % y).to_bigint() == a % b, "FixedInt / %", n);
+        check((x << s).to_bigint() == wrap(a << s) && (x >> s).to_bigint() == a >> s && (~x).to_bigint() == wrap(~a) &&
+                (x & y).to_bigint() == (a & b) && (x ^ y).to_bigint() == (a ^ b), "FixedInt shifts and bitwise", n);
+        check((x < y) == (a < b) && x.bit_length() == a.bit_length() && x.popcount() == a.popcount() &&
+                x.to_string(16) == a.to_string(16), "FixedInt comparison and conversion", n);
+        const FixedInt<Bits> fc(c), fd(d);
+        check(FixedInt<Bits>(c & d) == (fc & fd) && FixedInt<Bits>(c | d) == (fc | fd) &&
+                FixedInt<Bits>(c ^ d) == (fc ^ fd) && FixedInt<Bits>(~c) == ~fc, "bitwise of negatives against FixedInt", n);
+        return std::vector<BigInt>{ (x * y).to_bigint(), (x / y).to_bigint(), (-x).to_bigint() };
+    });
+}
+
+// arrays of mixed sizes, so the batches sort them into several runs, with the result in place of an operand too
+void check_batch(size_t n) {
+    std::vector<BigInt> a, b;
+    for (size_t i = 0; i < 40; ++i) {
+        a.push_back(random_signed(rng() % n + 1));
+        b.push_back(random_signed(rng() % n + 1));
+    }
+    compare("batch", n, [&] {
+        std::vector<BigInt> sums(a.size()), differences(a.size()), products(a.size()), in_place = a, parsed(a.size());
+        BigInt::add_batch(a, b, sums);
+        BigInt::sub_batch(a, b, differences);
+        BigInt::mul_batch(a, b, products);
+        BigInt::mul_batch(in_place, b, in_place);
+        std::vector<std::string> strings(a.size());
+        BigInt::to_string_batch(a, strings);
+        const std::vector<std::string_view> views(strings.begin(), strings.end());
+        BigInt::parse_batch(views, parsed);
+        bool ok = in_place == products && parsed == a;
+        for (size_t i = 0; i < a.size(); ++i) {
+            ok = ok && sums[i] == a[i] + b[i] && differences[i] == a[i] - b[i] && products[i] == a[i] * b[i] &&
+                strings[i] == a[i].to_string();
+        }
+        check(ok, "batch against one at a time", n);
+        std::vector<BigInt> aliased = a;
+        BigInt::add_batch(aliased, aliased, aliased);
+        for (size_t i = 0; i < a.size(); ++i) {
+            check(aliased[i] == a[i] + a[i], "batch with every span the same", n);
+        }
+        sums.insert(sums.end(), products.begin(), products.end());
+        return sums;
+    });
+}
+
+bool is_prime(ulonglong k) {
+    for (ulonglong d = 2; d * d <= k; ++d) {
+        if (k % d == 0) {
+            return false;
+        }
+    }
+    return k >= 2;
+}
+
+// factorial, binomial and primorial by their recurrences, and a product tree of numbers of very different sizes
+void check_product_tree(size_t n) {
+    const ulonglong k = 4 * n + rng() % 8, j = rng() % (k + 2);
+    std::vector<BigInt> leaves;
+    for (size_t i = 0; i < 20; ++i) {
+        leaves.push_back(random_limbs(i % 5 == 0 ? n : rng() % 3 + 1));
+    }
+    const BigInt x = random_signed(4 * n);
+    compare("product tree", n, [&] {
+        const BigInt factorial = BigInt::factorial(k), binomial = BigInt::binomial(k, j);
+        check(factorial == BigInt::factorial(k - 1) * BigInt((long long)k), "factorial", n);
+        check(binomial == (j > k ? BigInt(0) : factorial / (BigInt::factorial(j) * BigInt::factorial(k - j))) &&
+                BigInt::binomial(k, 3) == BigInt((long long)(k * (k - 1) * (k - 2) / 6)), "binomial", n);
+        const BigInt primorial = BigInt::primorial(k);
+        check(primorial == BigInt::primorial(k - 1) * (is_prime(k) ? BigInt((long long)k) : BigInt(1)), "primorial", n);
+        const ProductTree tree(leaves);
+        BigInt product = 1;
+        for (const BigInt &leaf : leaves) {
+            product *= leaf;
+        }
+        check(tree.product() == product && BigInt::product(leaves) == product, "product of the leaves", n);
+        const std::vector<BigInt> remainders = tree.remainders(x);
+        for (size_t i = 0; i < leaves.size(); ++i) {
+            check(remainders[i] == (x % leaves[i] + leaves[i]) % leaves[i], "ProductTree::remainders", n);
+        }
+        std::vector<BigInt> results = remainders;
+        results.insert(results.end(), { factorial, binomial, primorial, tree.product() });
+        return results;
+    });
+}
+
+// consecutive Fibonacci numbers of about n limbs, the pair with the most euclid steps for its size
+std::pair<BigInt, BigInt> fibonacci_pair(size_t n) {
+    BigInt a = 0, b = 1;
+    while (b.num_digits() < n) {
+        a += b;
+        std::swap(a, b);
+    }
+    return { a, b };
+}
+
+// a x + b y = g = gcd(a, b) with |x| <= |b| / (2 g) and |y| <= |a| / (2 g) where those are at least 1, and x =
+// sign(a) when b is 0
+void check_extended_gcd(const BigInt &a, const BigInt &b, size_t n) {
+    BigInt g, x, y;
+    BigInt::extended_gcd(a, b, g, x, y);
+    check(g == BigInt::gcd(a, b) && g >= 0, "extended_gcd g", n);
+    check(a * x + b * y == g, "extended_gcd a x + b y = g", n);
+    if (b == 0) {
+        check(x == (a > 0) - (a < 0), "extended_gcd x for b = 0", n);
+    } else if (g != 0) {
+        const BigInt twice = g << 1;
+        check(abs(x) <= std::max(BigInt(1), abs(b) / twice), "extended_gcd |x| bound", n);
+        check(abs(y) <= std::max(BigInt(1), abs(a) / twice), "extended_gcd |y| bound", n);
+    }
+}
+
+void check_gcd(size_t n) {
+    const BigInt a = random_signed(2 * n), b = random_signed(n), c = random_limbs(n / 2 + 1);
+    const auto [f0, f1] = fibonacci_pair(n);
+    // the orders and signs reach the swap and sign fix-ups around the half-gcd
+    const std::pair<BigInt, BigInt> pairs[] = {
+        { a, b }, { b, a }, { -a, b }, { a, -b }, { a * c, b * c }, { a, a }, { a, 0 }, { 0, b }, { a * c, c },
+        { f0, f1 }, { f1, -f0 }, { c * -3, c * 2 }, { c * 3, c * -2 }, // |b| / g = 2, where the bound has a tie
+    };
+    compare("gcd", n, [&] {
+        std::vector<BigInt> results;
+        for (const auto &[x, y] : pairs) {
+            check_extended_gcd(x, y, n);
+            results.push_back(BigInt::gcd(x, y));
+        }
+        if (b > 1 && BigInt::gcd(a, b) == 1) {
+            const BigInt inverse = BigInt::mod_inverse(a, b);
+            check(inverse >= 0 && inverse < b && (a * inverse % b + b) % b == 1, "mod_inverse", n);
+            results.push_back(inverse);
+        }
+        return results;
+    });
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: selfcheck [options]\n"
+        "  --max-limbs N   largest operand size in limbs (default 600), sizes grow by about a quarter from 1\n"
+        "  --rounds N      random operands per size (default 2)\n"
+        "  --seed N        seed for the operands (default 12345)\n");
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char *value = argv[++i];
+        if (arg == "--max-limbs") {
+            options.max_limbs = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--rounds") {
+            options.rounds = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--seed") {
+            rng.seed(std::strtoull(value, nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return options.max_limbs > 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    configs.push_back({ "default thresholds", BigInt::get_thresholds() });
+    configs.push_back({ "small thresholds", small() });
+    // each kernel tier the CPU has, on its own, with the small thresholds so every algorithm runs on it
+    const mpn::cpu_features cpu = mpn::detect_cpu_features();
+    mpn::cpu_features generic, bmi2, avx2, avx512;
+    bmi2.bmi2_adx = true;
+    avx2.avx2 = true;
+    avx512.avx512 = true;
+    configs.push_back({ "generic kernels", small(), generic });
+    if (cpu.bmi2_adx) {
+        configs.push_back({ "bmi2 kernels", small(), bmi2 });
+    }
+    if (cpu.avx2) {
+        configs.push_back({ "avx2 kernels", small(), avx2 });
+    }
+    if (cpu.avx512) {
+        configs.push_back({ "avx512 kernels", small(), avx512 });
+    }
+    // sub-products on a pool from a few limbs up
+    Thresholds parallel = small();
+    parallel.parallel = 16;
+    configs.push_back({ "three threads", parallel, cpu, 3 });
+    apply(configs[0]);
+
+    for (size_t n : sizes(options.max_limbs)) {
+        for (size_t round = 0; round < options.rounds; ++round) {
+            check_division(n);
+            check_multiplication(n);
+            check_to_string(n);
+            check_parse(n);
+            check_kernels(n);
+            check_toom(n);
+            check_unbalanced(n);
+            check_square(n);
+            check_pow(n);
+            check_modular(n);
+            check_linear_sum(n);
+            check_binary(random_signed(n), round == 0 ? BigInt() : random_signed(n / 3 + 1), n);
+            check_bitwise(n);
+            check_fixed<128>(n);
+            check_fixed<1024>(n);
+            check_batch(n);
+            check_product_tree(n);
+            check_gcd(n);
+        }
+        std::fprintf(stderr, "%zu limbs done\n", n);
+    }
+    check_binary(BigInt(), BigInt(-1), 0);
+    for (int x = -20; x <= 20; ++x) {
+        for (int y = -20; y <= 20; ++y) {
+            check_extended_gcd(x, y, 1);
+        }
+    }
+
+    std::printf("%zu checks, %zu failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
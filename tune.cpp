@@ -0,0 +1,203 @@
+#include "../include/BigInt.hpp"
+#include "../include/RandomOperands.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+// threshold tuning tool: measures the crossover points between algorithms on this machine and writes them as a
+// config file for Thresholds::read (or as a header with --header). each crossover is found by timing the operation
+// at growing sizes with the faster algorithm switched off and then switched on for the top level only, the
+// threshold is where switching to the faster algorithm saves the most. see usage() for the options
+
+namespace {
+
+const size_t NEVER = (size_t)1 << 40; // a threshold no operand reaches
+
+struct Options {
+    double min_time = 0.1; // seconds of timed batches per measurement
+    bool header = false;
+    std::string out;
+};
+
+// one threshold to tune: time(n) runs the operation once at size n, limit(t, n) sets the threshold in t so the
+// faster algorithm is used at the top level of an operation of size n and no further down. the search covers
+// [lo, hi], starting no lower than the threshold of the tier it takes over from (below, if there is one)
+struct Tunable {
+    const char *name;
+    size_t Thresholds::*value;
+    size_t Thresholds::*below;
+    size_t lo, hi;
+    std::function<void(size_t)> prepare;
+    std::function<void()> time;
+    std::function<void(Thresholds &, size_t)> limit;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// best time per call over five batches of about min_time / 5 each
+double measure(const std::function<void()> &f, double min_time) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    const double once = seconds_since(start);
+    const size_t batch = std::max<size_t>(1, (size_t)(min_time / 5 / std::max(once, 1e-9)));
+    double best = once;
+    for (int round = 0; round < 5; ++round) {
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; ++i) {
+            f();
+        }
+        best = std::min(best, seconds_since(start) / batch);
+    }
+    return best;
+}
+
+std::vector<Tunable> tunables() {
+    static BigInt a, b, divisor, dividend;
+    static std::string decimal;
+    const auto two_operands = [](size_t n) { a = random_limbs(n); b = random_limbs(n); };
+    const auto one_operand = [](size_t n) { a = random_limbs(n); };
+    const auto mul = [] { (a * b).num_digits(); };
+    const auto sqr = [] { a.square().num_digits(); };
+    // the multiplication tiers above the one being tuned are switched off, it competes with the one below
+    return {
+        { "karatsuba", &Thresholds::karatsuba, nullptr, 4, 300, two_operands, mul,
+          [](Thresholds &t, size_t n) { t.karatsuba = n; t.toom3 = t.toom4 = t.ntt = NEVER; } },
+        { "sqr_karatsuba", &Thresholds::sqr_karatsuba, nullptr, 4, 400, one_operand, sqr,
+          [](Thresholds &t, size_t n) { t.sqr_karatsuba = n; t.toom3 = t.toom4 = t.ntt = NEVER; } },
+        { "toom3", &Thresholds::toom3, &Thresholds::karatsuba, 16, 3000, two_operands, mul,
+          [](Thresholds &t, size_t n) { t.toom3 = n; t.toom4 = t.ntt = NEVER; } },
+        { "toom4", &Thresholds::toom4, &Thresholds::toom3, 16, 6000, two_operands, mul,
+          [](Thresholds &t, size_t n) { t.toom4 = n; t.ntt = NEVER; } },
+        { "ntt", &Thresholds::ntt, nullptr, 500, std::min<size_t>(200000, NTT_MAX_LENGTH / 2), two_operands, mul,
+          [](Thresholds &t, size_t n) { t.ntt = n; } },
+        { "burnikel_ziegler", &Thresholds::burnikel_ziegler, nullptr, 4, 1000,
+          [](size_t n) { dividend = random_limbs(2 * n); divisor = random_limbs(n); },
+          [] { (dividend / divisor).num_digits(); },
+          [](Thresholds &t, size_t n) { t.burnikel_ziegler = n; } },
+        { "to_string", &Thresholds::to_string, nullptr, 4, 1000, one_operand, [] { a.to_string().size(); },
+          [](Thresholds &t, size_t n) { t.to_string = n; } },
+        { "parse", &Thresholds::parse, nullptr, 2, 1000,
+          [](size_t n) { // n base 10^9 chunks
+              decimal = "1";
+              for (size_t i = 1; i < n * POW10_DIGITS; ++i) {
+                  decimal.push_back((char)('0' + rng() % 10));
+              }
+          },
+          [] { BigInt(decimal).num_digits(); },
+          [](Thresholds &t, size_t n) { t.parse = n - 1; } }, // parsing splits above the threshold
+        { "hgcd", &Thresholds::hgcd, nullptr, 16, 3000, two_operands, [] { BigInt::gcd(a, b).num_digits(); },
+          [](Thresholds &t, size_t n) { t.hgcd = n; } },
+    };
+}
+
+// times both algorithms at growing sizes until the faster one has won four sizes in a row (or hi is reached). the
+// threshold is the size from which switching saves the most, i.e. the start of the run of measured sizes with the
+// lowest total log(fast / slow). that rides out single noisy sizes and the steps in the transform's cost, where the
+// first win would not. hi means the faster algorithm never paid off
+size_t crossover(const Tunable &tunable, const Thresholds &tuned, double min_time) {
+    std::vector<std::pair<size_t, double>> log_ratios;
+    size_t wins = 0;
+    const size_t lo = tunable.below ? std::max(tunable.lo, tuned.*tunable.below) : tunable.lo;
+    for (size_t n = lo; n <= tunable.hi && wins < 4; n = std::max(n + 1, n * 23 / 20)) {
+        tunable.prepare(n);
+        Thresholds without = tuned, with = tuned;
+        tunable.limit(without, n + 1);
+        tunable.limit(with, n);
+        BigInt::set_thresholds(without);
+        const double slow = measure(tunable.time, min_time);
+        BigInt::set_thresholds(with);
+        const double fast = measure(tunable.time, min_time);
+        std::fprintf(stderr, "%-16s %7zu: %.3f\n", tunable.name, n, fast / slow);
+        log_ratios.emplace_back(n, std::log(fast / slow));
+        wins = fast < slow ? wins + 1 : 0;
+    }
+
+    size_t threshold = tunable.hi;
+    double suffix = 0, best = 0;
+    for (size_t i = log_ratios.size(); i-- > 0;) {
+        suffix += log_ratios[i].second;
+        if (suffix < best) {
+            best = suffix;
+            threshold = log_ratios[i].first;
+        }
+    }
+    return threshold;
+}
+
+void write_header(std::ostream &out, const Thresholds &tuned) {
+    std::stringstream config;
+    tuned.write(config);
+    out << "// crossover points measured by tune.cpp, install them with BigInt::set_thresholds(TUNED_THRESHOLDS)\n"
+           "#pragma once\n#include \"BigInt.hpp\"\n\ninline const Thresholds TUNED_THRESHOLDS{\n";
+    for (std::string name, equals, value; config >> name >> equals >> value;) {
+        out << "\t." << name << " = " << value << ",\n";
+    }
+    out << "};\n";
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: tune [options]\n"
+        "  --min-time S   seconds spent timing each measurement (default 0.1)\n"
+        "  --header       write a C++ header defining TUNED_THRESHOLDS instead of a config file\n"
+        "  --out FILE     write to FILE instead of stdout\n"
+        "the parallel threshold depends on the thread count and keeps its current value\n");
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--header") {
+            options.header = true;
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.min_time = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--out" && i + 1 < argc) {
+            options.out = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    // each threshold is measured with the ones tuned before it in place
+    Thresholds tuned = BigInt::get_thresholds();
+    for (const Tunable &tunable : tunables()) {
+        const size_t value = crossover(tunable, tuned, options.min_time);
+        Thresholds result = tuned;
+        tunable.limit(result, value);
+        tuned.*tunable.value = result.*tunable.value;
+        BigInt::set_thresholds(tuned);
+        std::fprintf(stderr, "%-16s = %zu\n", tunable.name, tuned.*tunable.value);
+    }
+
+    std::ofstream file;
+    if (!options.out.empty()) {
+        file.open(options.out);
+        if (!file) {
+            std::fprintf(stderr, "cannot open %s\n", options.out.c_str());
+            return 1;
+        }
+    }
+    std::ostream &out = options.out.empty() ? std::cout : file;
+    if (options.header) {
+        write_header(out, tuned);
+    } else {
+        out << "# crossover points measured by tune.cpp, load them with BigInt::set_thresholds(Thresholds::read(in))\n";
+        tuned.write(out);
+    }
+    return 0;
+}